@@ -0,0 +1,698 @@
+#include "CaptureImage.hpp"
+#include "../hyprmagnifier.hpp"
+#include "Formats.hpp"
+
+#include <atomic>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+bool CCaptureImage::supportsFormat(uint32_t format) {
+    return Formats::info(format);
+}
+
+bool CCaptureImage::isHighPrecisionFormat(uint32_t format) {
+    const auto INFO = Formats::info(format);
+    return INFO && INFO->bits > 8;
+}
+
+CCaptureImage::CCaptureImage(const Vector2D& size, const std::string& owner, bool highPrecision) : m_vSize(size), m_bHighPrecision(highPrecision), m_szOwner(owner) {
+    m_iWidth  = size.x;
+    m_iHeight = size.y;
+    m_iTilesX = (m_iWidth + TILE_SIZE - 1) / TILE_SIZE;
+    m_iTilesY = (m_iHeight + TILE_SIZE - 1) / TILE_SIZE;
+
+    m_iTilesBytes = (size_t)m_iTilesX * m_iTilesY * TILE_SIZE * TILE_SIZE * sizeof(uint32_t);
+    m_pTiles      = (uint32_t*)mmap(nullptr, m_iTilesBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (m_pTiles == MAP_FAILED) {
+        Debug::log(CRIT, "Failed to map %zu bytes for the capture tiles", m_iTilesBytes);
+        exit(1);
+    }
+
+    m_vTileReady.resize((size_t)m_iTilesX * m_iTilesY, 0);
+    m_vTileCommitted.resize((size_t)m_iTilesX * m_iTilesY, 0);
+
+    // every level halves the one below, rounding up so an odd last column or row is never dropped
+    for (int level = 1, w = m_iWidth, h = m_iHeight; level < MIP_LEVELS && (w > 1 || h > 1); ++level) {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+
+        auto& mip  = m_vMips.emplace_back();
+        mip.width  = w;
+        mip.height = h;
+        mip.tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+        mip.tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+        mip.bytes  = (size_t)mip.tilesX * mip.tilesY * TILE_SIZE * TILE_SIZE * sizeof(uint32_t);
+        mip.tiles  = (uint32_t*)mmap(nullptr, mip.bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+        if (mip.tiles == MAP_FAILED) {
+            Debug::log(CRIT, "Failed to map %zu bytes for mip level %d", mip.bytes, level);
+            exit(1);
+        }
+
+        mip.ready.resize((size_t)mip.tilesX * mip.tilesY, 0);
+        mip.committed.resize((size_t)mip.tilesX * mip.tilesY, 0);
+    }
+
+    while ((size_t)(m_iWidth / m_iPreviewFactor) * (m_iHeight / m_iPreviewFactor) > PREVIEW_MAX_PIXELS)
+        m_iPreviewFactor *= 2;
+
+    m_iPreviewWidth  = std::max(m_iWidth / m_iPreviewFactor, 1);
+    m_iPreviewHeight = std::max(m_iHeight / m_iPreviewFactor, 1);
+    m_vPreview.resize((size_t)m_iPreviewWidth * m_iPreviewHeight);
+    m_pPreviewSurface =
+        cairo_image_surface_create_for_data((unsigned char*)m_vPreview.data(), cairoFormat(), m_iPreviewWidth, m_iPreviewHeight, m_iPreviewWidth * 4);
+
+    g_pHyprmagnifier->m_pMemoryTracker->onAlloc(MEM_PREVIEW, m_szOwner, m_vPreview.size() * sizeof(uint32_t));
+}
+
+CCaptureImage::~CCaptureImage() {
+    cairo_surface_destroy(m_pPreviewSurface);
+    munmap(m_pTiles, m_iTilesBytes);
+    for (auto& mip : m_vMips) {
+        munmap(mip.tiles, mip.bytes);
+    }
+
+    g_pHyprmagnifier->m_pMemoryTracker->onFree(MEM_PREVIEW, m_szOwner, m_vPreview.size() * sizeof(uint32_t));
+    g_pHyprmagnifier->m_pMemoryTracker->onFree(MEM_TILES, m_szOwner, committedBytes());
+}
+
+void CCaptureImage::setSource(SP<SPoolBuffer> raw, wl_output_transform transform) {
+    const auto INFO = Formats::info(raw->format);
+
+    // shared by every image, so a new image never looks like one drawn before
+    static std::atomic<uint64_t> generations = 0;
+
+    m_pRaw        = raw;
+    m_pConvert    = m_bHighPrecision ? INFO->to10Bit : INFO->to8Bit;
+    m_iGeneration = ++generations;
+
+    const ssize_t BPP    = INFO->bytes;
+    const ssize_t STRIDE = raw->stride;
+
+    // same orientation as the old cairo transform pass, flips are still ignored
+    switch (transform % 4) {
+        case 0:
+            m_iOrigin = 0;
+            m_iStepX  = BPP;
+            m_iStepY  = STRIDE;
+            break;
+        case 1:
+            m_iOrigin = (m_iWidth - 1) * STRIDE;
+            m_iStepX  = -STRIDE;
+            m_iStepY  = BPP;
+            break;
+        case 2:
+            m_iOrigin = (m_iHeight - 1) * STRIDE + (m_iWidth - 1) * BPP;
+            m_iStepX  = -BPP;
+            m_iStepY  = -STRIDE;
+            break;
+        case 3:
+            m_iOrigin = (m_iHeight - 1) * BPP;
+            m_iStepX  = STRIDE;
+            m_iStepY  = -BPP;
+            break;
+    }
+
+    std::fill(m_vTileReady.begin(), m_vTileReady.end(), 0);
+    for (auto& mip : m_vMips) {
+        std::fill(mip.ready.begin(), mip.ready.end(), 0);
+    }
+    m_iConvertedTiles = 0;
+
+    buildPreview();
+}
+
+const uint8_t* CCaptureImage::rawPixel(int x, int y) const {
+    return (const uint8_t*)m_pRaw->data + m_iOrigin + x * m_iStepX + y * m_iStepY;
+}
+
+// point samples the center of every factor x factor block
+void CCaptureImage::buildPreview() {
+    const int HALF = m_iPreviewFactor / 2;
+
+    cairo_surface_flush(m_pPreviewSurface);
+
+    // the preview is at most size / factor, so a block center never leaves the image
+    for (int y = 0; y < m_iPreviewHeight; ++y) {
+        m_pConvert(rawPixel(HALF, y * m_iPreviewFactor + HALF), m_iStepX * m_iPreviewFactor, m_vPreview.data() + (size_t)y * m_iPreviewWidth, m_iPreviewWidth);
+    }
+
+    cairo_surface_mark_dirty(m_pPreviewSurface);
+}
+
+void CCaptureImage::convertTile(int tx, int ty, uint32_t* out) {
+    const int X0 = tx * TILE_SIZE, Y0 = ty * TILE_SIZE;
+    const int W = std::min(TILE_SIZE, m_iWidth - X0), H = std::min(TILE_SIZE, m_iHeight - Y0);
+
+    for (int y = 0; y < H; ++y) {
+        m_pConvert(rawPixel(X0, Y0 + y), m_iStepX, out + y * TILE_SIZE, W);
+    }
+}
+
+const uint32_t* CCaptureImage::tile(int tx, int ty) {
+    const size_t INDEX = (size_t)ty * m_iTilesX + tx;
+    uint32_t*    data  = m_pTiles + INDEX * TILE_SIZE * TILE_SIZE;
+
+    if (!m_vTileReady[INDEX]) {
+        // pages stay committed across recaptures, only the first conversion of a tile costs memory
+        if (!m_vTileCommitted[INDEX]) {
+            m_vTileCommitted[INDEX] = 1;
+            m_iCommittedTiles++;
+            g_pHyprmagnifier->m_pMemoryTracker->onAlloc(MEM_TILES, m_szOwner, TILE_SIZE * TILE_SIZE * sizeof(uint32_t));
+        }
+
+        convertTile(tx, ty, data);
+        m_vTileReady[INDEX] = 1;
+        m_iConvertedTiles++;
+    }
+
+    return data;
+}
+
+void CCaptureImage::sampleNearest(uint32_t* dst, size_t dstStride, int x0, int y0, int w, int h, const Vector2D& srcOrigin, double scale) {
+    if (!m_pRaw)
+        return;
+
+    for (int y = y0; y < y0 + h; ++y) {
+        const int SY = std::floor(srcOrigin.y + scale * (y + 0.5));
+        if (SY < 0 || SY >= m_iHeight)
+            continue;
+
+        uint32_t*       row      = (uint32_t*)((uint8_t*)dst + (y - y0) * dstStride);
+        const uint32_t* tileRow  = nullptr;
+        int             lastTile = -1;
+
+        for (int x = x0; x < x0 + w; ++x) {
+            const int SX = std::floor(srcOrigin.x + scale * (x + 0.5));
+            if (SX < 0 || SX >= m_iWidth)
+                continue;
+
+            if (SX / TILE_SIZE != lastTile) {
+                lastTile = SX / TILE_SIZE;
+                tileRow  = tile(lastTile, SY / TILE_SIZE) + (SY % TILE_SIZE) * TILE_SIZE;
+            }
+
+            row[x - x0] = tileRow[SX % TILE_SIZE];
+        }
+    }
+}
+
+// the 2x2 box average of four pixels, per channel and rounded
+static uint32_t box8Bit(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    // two channels per add, a lane holds at most 4 * 255 + 2
+    const uint32_t RB = (((a & 0xFF00FF) + (b & 0xFF00FF) + (c & 0xFF00FF) + (d & 0xFF00FF) + 0x20002) >> 2) & 0xFF00FF;
+    const uint32_t AG = ((((a >> 8) & 0xFF00FF) + ((b >> 8) & 0xFF00FF) + ((c >> 8) & 0xFF00FF) + ((d >> 8) & 0xFF00FF) + 0x20002) >> 2) & 0xFF00FF;
+    return RB | (AG << 8);
+}
+
+static uint32_t box10Bit(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    uint32_t out = 0xC0000000;
+    for (int shift = 0; shift < 30; shift += 10) {
+        const uint32_t SUM = ((a >> shift) & 0x3FF) + ((b >> shift) & 0x3FF) + ((c >> shift) & 0x3FF) + ((d >> shift) & 0x3FF);
+        out |= ((SUM + 2) >> 2) << shift;
+    }
+    return out;
+}
+
+// count pixels out of the 2x2 blocks of two rows
+static void reduceRow8Bit(const uint32_t* top, const uint32_t* bottom, uint32_t* out, int count) {
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128i ZERO  = _mm_setzero_si128();
+    const __m128i ROUND = _mm_set1_epi16(2);
+
+    // two rows of 16-bit channels added, then the pixel pairs of a block folded onto each other
+    const auto PAIR = [&](const uint32_t* t, const uint32_t* b) {
+        const __m128i T  = _mm_loadu_si128((const __m128i*)t);
+        const __m128i B  = _mm_loadu_si128((const __m128i*)b);
+        const __m128i LO = _mm_add_epi16(_mm_unpacklo_epi8(T, ZERO), _mm_unpacklo_epi8(B, ZERO));
+        const __m128i HI = _mm_add_epi16(_mm_unpackhi_epi8(T, ZERO), _mm_unpackhi_epi8(B, ZERO));
+        return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi64(LO, HI), _mm_unpackhi_epi64(LO, HI)), ROUND), 2);
+    };
+
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(PAIR(top + i * 2, bottom + i * 2), PAIR(top + i * 2 + 4, bottom + i * 2 + 4)));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        out[i] = box8Bit(top[i * 2], top[i * 2 + 1], bottom[i * 2], bottom[i * 2 + 1]);
+    }
+}
+
+static void reduceRow10Bit(const uint32_t* top, const uint32_t* bottom, uint32_t* out, int count) {
+    for (int i = 0; i < count; ++i) {
+        out[i] = box10Bit(top[i * 2], top[i * 2 + 1], bottom[i * 2], bottom[i * 2 + 1]);
+    }
+}
+
+// a + (b - a) * t / 256 per channel
+static uint32_t mix8Bit(uint32_t a, uint32_t b, uint32_t t) {
+    // weights add up to 256, so a lane never carries into the next one
+    const uint32_t RB = ((((a & 0xFF00FF) * (256 - t) + (b & 0xFF00FF) * t + 0x800080) >> 8) & 0xFF00FF);
+    const uint32_t AG = ((((a >> 8) & 0xFF00FF) * (256 - t) + ((b >> 8) & 0xFF00FF) * t + 0x800080) & 0xFF00FF00);
+    return RB | AG;
+}
+
+static uint32_t mix10Bit(uint32_t a, uint32_t b, uint32_t t) {
+    uint32_t out = 0xC0000000;
+    for (int shift = 0; shift < 30; shift += 10) {
+        out |= ((((a >> shift) & 0x3FF) * (256 - t) + ((b >> shift) & 0x3FF) * t + 128) >> 8) << shift;
+    }
+    return out;
+}
+
+#if defined(__SSE2__)
+// mix8Bit of four pixel pairs, t and 256 - t as 16-bit lanes matching the channels of the two pixels in each half
+static __m128i mix8BitX4(__m128i a, __m128i b, __m128i tLo, __m128i tHi) {
+    const __m128i ZERO  = _mm_setzero_si128();
+    const __m128i FULL  = _mm_set1_epi16(256);
+    const __m128i ROUND = _mm_set1_epi16(128);
+
+    // a * (256 - t) + b * t stays below 65536, so 16-bit lanes hold it unsigned
+    const auto HALF = [&](__m128i a16, __m128i b16, __m128i t) {
+        const __m128i SUM = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(a16, _mm_sub_epi16(FULL, t)), _mm_mullo_epi16(b16, t)), ROUND);
+        return _mm_srli_epi16(SUM, 8);
+    };
+
+    return _mm_packus_epi16(HALF(_mm_unpacklo_epi8(a, ZERO), _mm_unpacklo_epi8(b, ZERO), tLo), HALF(_mm_unpackhi_epi8(a, ZERO), _mm_unpackhi_epi8(b, ZERO), tHi));
+}
+#endif
+
+// out = a + (b - a) * t / 256 for count pixels, one weight for all of them
+static void mixRow8Bit(const uint32_t* a, const uint32_t* b, uint32_t* out, int count, uint32_t t) {
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128i T = _mm_set1_epi16(t);
+
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i*)(out + i), mix8BitX4(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)), T, T));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        out[i] = mix8Bit(a[i], b[i], t);
+    }
+}
+
+static void mixRow10Bit(const uint32_t* a, const uint32_t* b, uint32_t* out, int count, uint32_t t) {
+    for (int i = 0; i < count; ++i) {
+        out[i] = mix10Bit(a[i], b[i], t);
+    }
+}
+
+// out[i] = line[left[i]] + (line[right[i]] - line[left[i]]) * weight[i] / 256
+static void mixTaps8Bit(const uint32_t* line, const int* left, const int* right, const uint32_t* weight, uint32_t* out, int count) {
+    int i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        const __m128i A = _mm_setr_epi32(line[left[i]], line[left[i + 1]], line[left[i + 2]], line[left[i + 3]]);
+        const __m128i B = _mm_setr_epi32(line[right[i]], line[right[i + 1]], line[right[i + 2]], line[right[i + 3]]);
+
+        // t0 t1 t2 t3 spread over the four channels of their pixel
+        const __m128i W16 = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(weight + i)), _mm_setzero_si128());
+        const __m128i W   = _mm_unpacklo_epi16(W16, W16);
+
+        _mm_storeu_si128((__m128i*)(out + i), mix8BitX4(A, B, _mm_unpacklo_epi32(W, W), _mm_unpackhi_epi32(W, W)));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        out[i] = mix8Bit(line[left[i]], line[right[i]], weight[i]);
+    }
+}
+
+static void mixTaps10Bit(const uint32_t* line, const int* left, const int* right, const uint32_t* weight, uint32_t* out, int count) {
+    for (int i = 0; i < count; ++i) {
+        out[i] = mix10Bit(line[left[i]], line[right[i]], weight[i]);
+    }
+}
+
+int CCaptureImage::levelWidth(int level) const {
+    return level ? m_vMips[level - 1].width : m_iWidth;
+}
+
+int CCaptureImage::levelHeight(int level) const {
+    return level ? m_vMips[level - 1].height : m_iHeight;
+}
+
+int CCaptureImage::levelTilesX(int level) const {
+    return level ? m_vMips[level - 1].tilesX : m_iTilesX;
+}
+
+int CCaptureImage::levelTilesY(int level) const {
+    return level ? m_vMips[level - 1].tilesY : m_iTilesY;
+}
+
+int CCaptureImage::levelFor(double scale) const {
+    return scale > 1.0 ? std::min((int)std::log2(scale), (int)m_vMips.size()) : 0;
+}
+
+// the four tiles below make up one tile of the level, each of them reduced into its quadrant
+void CCaptureImage::reduceTile(int level, int tx, int ty, uint32_t* out) {
+    const int HALF = TILE_SIZE / 2;
+
+    for (int qy = 0; qy < 2; ++qy) {
+        for (int qx = 0; qx < 2; ++qx) {
+            const int CX = tx * 2 + qx, CY = ty * 2 + qy;
+            if (CX >= levelTilesX(level - 1) || CY >= levelTilesY(level - 1))
+                continue;
+
+            const uint32_t* CHILD    = levelTile(level - 1, CX, CY);
+            const int       W        = std::min(TILE_SIZE, levelWidth(level - 1) - CX * TILE_SIZE);
+            const int       H        = std::min(TILE_SIZE, levelHeight(level - 1) - CY * TILE_SIZE);
+            uint32_t*       quadrant = out + qy * HALF * TILE_SIZE + qx * HALF;
+
+            for (int y = 0; y < (H + 1) / 2; ++y) {
+                // an odd last row or column makes a block with itself
+                const uint32_t* TOP    = CHILD + y * 2 * TILE_SIZE;
+                const uint32_t* BOTTOM = CHILD + std::min(y * 2 + 1, H - 1) * TILE_SIZE;
+                uint32_t*       row    = quadrant + y * TILE_SIZE;
+
+                if (m_bHighPrecision)
+                    reduceRow10Bit(TOP, BOTTOM, row, W / 2);
+                else
+                    reduceRow8Bit(TOP, BOTTOM, row, W / 2);
+
+                if (W % 2)
+                    row[W / 2] = m_bHighPrecision ? box10Bit(TOP[W - 1], TOP[W - 1], BOTTOM[W - 1], BOTTOM[W - 1]) :
+                                                    box8Bit(TOP[W - 1], TOP[W - 1], BOTTOM[W - 1], BOTTOM[W - 1]);
+            }
+        }
+    }
+}
+
+const uint32_t* CCaptureImage::levelTile(int level, int tx, int ty) {
+    if (!level)
+        return tile(tx, ty);
+
+    auto&        mip   = m_vMips[level - 1];
+    const size_t INDEX = (size_t)ty * mip.tilesX + tx;
+    uint32_t*    data  = mip.tiles + INDEX * TILE_SIZE * TILE_SIZE;
+
+    if (!mip.ready[INDEX]) {
+        if (!mip.committed[INDEX]) {
+            mip.committed[INDEX] = 1;
+            m_iCommittedTiles++;
+            g_pHyprmagnifier->m_pMemoryTracker->onAlloc(MEM_TILES, m_szOwner, TILE_SIZE * TILE_SIZE * sizeof(uint32_t));
+        }
+
+        reduceTile(level, tx, ty, data);
+        mip.ready[INDEX] = 1;
+    }
+
+    return data;
+}
+
+// pixels from to to of a row of a level, out of its tiles
+void CCaptureImage::levelSpan(int level, int y, int from, int to, uint32_t* out) {
+    for (int tx = from / TILE_SIZE; tx <= (to - 1) / TILE_SIZE; ++tx) {
+        const int FROM = std::max(from, tx * TILE_SIZE);
+        const int TO   = std::min(to, (tx + 1) * TILE_SIZE);
+        memcpy(out + (FROM - from), levelTile(level, tx, y / TILE_SIZE) + (y % TILE_SIZE) * TILE_SIZE + (FROM - tx * TILE_SIZE), (TO - FROM) * sizeof(uint32_t));
+    }
+}
+
+// the horizontal taps only depend on the column, so they are worked out once per call. Every row then reads two spans
+// of level pixels, blends them vertically with one weight and horizontally through the taps, a handful of pixels per
+// instruction either way and a tile lookup per 64 pixels of span instead of four per tap
+void CCaptureImage::sampleTrilinear(uint32_t* dst, size_t dstStride, int x0, int y0, int w, int h, const Vector2D& srcOrigin, double scale) {
+    if (!m_pRaw)
+        return;
+
+    const int      TOP    = m_vMips.size();
+    const double   LOD    = std::clamp(std::log2(scale), 0.0, (double)TOP);
+    const int      LOWER  = std::min((int)LOD, TOP);
+    const int      UPPER  = std::min(LOWER + 1, TOP);
+    const uint32_t BLEND  = UPPER == LOWER ? 0 : std::round((LOD - LOWER) * 256);
+    const int      LEVELS = BLEND ? 2 : 1;
+    const auto     MIXROW = m_bHighPrecision ? mixRow10Bit : mixRow8Bit;
+    const auto     MIXTAP = m_bHighPrecision ? mixTaps10Bit : mixTaps8Bit;
+
+    // the columns that land inside the image, the source x only ever grows with x
+    int xa = x0, xb = x0 + w;
+    while (xa < xb && srcOrigin.x + scale * (xa + 0.5) < 0) {
+        xa++;
+    }
+    while (xb > xa && srcOrigin.x + scale * (xb - 0.5) >= m_iWidth) {
+        xb--;
+    }
+
+    const int COUNT = xb - xa;
+    if (COUNT <= 0)
+        return;
+
+    for (int l = 0; l < LEVELS; ++l) {
+        const int LEVEL = l ? UPPER : LOWER;
+        const int LW    = levelWidth(LEVEL);
+        auto&     taps  = m_aTaps[l];
+
+        taps.left.resize(COUNT);
+        taps.right.resize(COUNT);
+        taps.weight.resize(COUNT);
+
+        for (int i = 0; i < COUNT; ++i) {
+            const double U  = std::ldexp(srcOrigin.x + scale * (xa + i + 0.5), -LEVEL) - 0.5;
+            const int    IX = std::floor(U);
+
+            // clamped to the level, so taps at the border repeat the edge
+            taps.left[i]   = std::clamp(IX, 0, LW - 1);
+            taps.right[i]  = std::clamp(IX + 1, 0, LW - 1);
+            taps.weight[i] = (U - IX) * 256;
+        }
+
+        taps.from = taps.left.front();
+        taps.to   = taps.right.back() + 1;
+
+        for (int i = 0; i < COUNT; ++i) {
+            taps.left[i] -= taps.from;
+            taps.right[i] -= taps.from;
+        }
+    }
+
+    m_vSpanTop.resize(std::max(m_aTaps[0].to - m_aTaps[0].from, LEVELS > 1 ? m_aTaps[1].to - m_aTaps[1].from : 0));
+    m_vSpanBottom.resize(m_vSpanTop.size());
+    m_vLevelRow.resize(COUNT);
+
+    for (int y = y0; y < y0 + h; ++y) {
+        const double SY = srcOrigin.y + scale * (y + 0.5);
+        if (SY < 0 || SY >= m_iHeight)
+            continue;
+
+        uint32_t* row = (uint32_t*)((uint8_t*)dst + (y - y0) * dstStride) + (xa - x0);
+
+        for (int l = 0; l < LEVELS; ++l) {
+            const int      LEVEL = l ? UPPER : LOWER;
+            const auto&    TAPS  = m_aTaps[l];
+            const int      SPAN  = TAPS.to - TAPS.from;
+            const double   V     = std::ldexp(SY, -LEVEL) - 0.5;
+            const int      IY    = std::floor(V);
+            const uint32_t FY    = (V - IY) * 256;
+            const int      LH    = levelHeight(LEVEL);
+
+            levelSpan(LEVEL, std::clamp(IY, 0, LH - 1), TAPS.from, TAPS.to, m_vSpanTop.data());
+            levelSpan(LEVEL, std::clamp(IY + 1, 0, LH - 1), TAPS.from, TAPS.to, m_vSpanBottom.data());
+
+            MIXROW(m_vSpanTop.data(), m_vSpanBottom.data(), m_vSpanTop.data(), SPAN, FY);
+            MIXTAP(m_vSpanTop.data(), TAPS.left.data(), TAPS.right.data(), TAPS.weight.data(), l ? m_vLevelRow.data() : row, COUNT);
+        }
+
+        if (BLEND)
+            MIXROW(row, m_vLevelRow.data(), row, COUNT, BLEND);
+    }
+}
+
+void CCaptureImage::sample(uint32_t* dst, size_t dstStride, int x0, int y0, int w, int h, const Vector2D& srcOrigin, double scale) {
+    if (scale > 1.0)
+        sampleTrilinear(dst, dstStride, x0, y0, w, h, srcOrigin, scale);
+    else
+        sampleNearest(dst, dstStride, x0, y0, w, h, srcOrigin, scale);
+}
+
+uint32_t CCaptureImage::pixel(int x, int y) {
+    if (!m_pRaw || x < 0 || y < 0 || x >= m_iWidth || y >= m_iHeight)
+        return 0;
+
+    return tile(x / TILE_SIZE, y / TILE_SIZE)[(y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE];
+}
+
+bool CCaptureImage::prepare(int x, int y, int w, int h) {
+    const int X0 = std::max(x, 0), Y0 = std::max(y, 0);
+    const int X1 = std::min(x + w, m_iWidth), Y1 = std::min(y + h, m_iHeight);
+
+    if (!m_pRaw)
+        return false;
+
+    if (X0 >= X1 || Y0 >= Y1)
+        return true;
+
+    for (int ty = Y0 / TILE_SIZE; ty <= (Y1 - 1) / TILE_SIZE; ++ty) {
+        for (int tx = X0 / TILE_SIZE; tx <= (X1 - 1) / TILE_SIZE; ++tx) {
+            tile(tx, ty);
+        }
+    }
+
+    return true;
+}
+
+const uint32_t* CCaptureImage::tileRow(int tx, int y) const {
+    return m_pTiles + ((size_t)(y / TILE_SIZE) * m_iTilesX + tx) * TILE_SIZE * TILE_SIZE + (y % TILE_SIZE) * TILE_SIZE;
+}
+
+// folds count ARGB32 pixels into stats. A span is at most a tile row, so the 32-bit lane sums can't overflow
+static void accumulate8Bit(SRegionStats& stats, const uint32_t* data, int count) {
+    int      i       = 0;
+    uint32_t sums[3] = {}, lo = 0xFFFFFFFF, hi = 0;
+
+#if defined(__SSE2__)
+    const __m128i ZERO = _mm_setzero_si128();
+    __m128i       sum  = ZERO;
+    __m128i       minv = _mm_set1_epi8((char)0xFF);
+    __m128i       maxv = ZERO;
+
+    for (; i + 4 <= count; i += 4) {
+        const __m128i PX = _mm_loadu_si128((const __m128i*)(data + i));
+
+        // bytes are per channel already, so min and max need no unpacking
+        minv = _mm_min_epu8(minv, PX);
+        maxv = _mm_max_epu8(maxv, PX);
+
+        // two pixels of 16-bit channels, then both folded into one pixel of 32-bit channels
+        const __m128i PAIRS = _mm_add_epi16(_mm_unpacklo_epi8(PX, ZERO), _mm_unpackhi_epi8(PX, ZERO));
+        sum                 = _mm_add_epi32(sum, _mm_add_epi32(_mm_unpacklo_epi16(PAIRS, ZERO), _mm_unpackhi_epi16(PAIRS, ZERO)));
+    }
+
+    alignas(16) uint32_t lanes[4];
+    _mm_store_si128((__m128i*)lanes, sum);
+    sums[0] = lanes[2];
+    sums[1] = lanes[1];
+    sums[2] = lanes[0];
+
+    // the lanes still hold four pixels each, fold them channel-wise with the same byte ops
+    minv = _mm_min_epu8(minv, _mm_srli_si128(minv, 8));
+    minv = _mm_min_epu8(minv, _mm_srli_si128(minv, 4));
+    maxv = _mm_max_epu8(maxv, _mm_srli_si128(maxv, 8));
+    maxv = _mm_max_epu8(maxv, _mm_srli_si128(maxv, 4));
+    lo   = _mm_cvtsi128_si32(minv);
+    hi   = _mm_cvtsi128_si32(maxv);
+#endif
+
+    for (; i < count; ++i) {
+        const uint32_t PX = data[i];
+        sums[0] += (PX >> 16) & 0xFF;
+        sums[1] += (PX >> 8) & 0xFF;
+        sums[2] += PX & 0xFF;
+
+        for (int shift = 0; shift < 24; shift += 8) {
+            const uint32_t MASK = 0xFFu << shift;
+            lo                  = (lo & ~MASK) | std::min(lo & MASK, PX & MASK);
+            hi                  = (hi & ~MASK) | std::max(hi & MASK, PX & MASK);
+        }
+    }
+
+    for (int c = 0; c < 3; ++c) {
+        const int SHIFT = 16 - c * 8;
+        stats.sum[c] += sums[c];
+        stats.min[c] = std::min<uint16_t>(stats.min[c], (lo >> SHIFT) & 0xFF);
+        stats.max[c] = std::max<uint16_t>(stats.max[c], (hi >> SHIFT) & 0xFF);
+    }
+    stats.pixels += count;
+}
+
+static void accumulate10Bit(SRegionStats& stats, const uint32_t* data, int count) {
+    for (int i = 0; i < count; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            const uint16_t V = (data[i] >> (20 - c * 10)) & 0x3FF;
+            stats.sum[c] += V;
+            stats.min[c] = std::min(stats.min[c], V);
+            stats.max[c] = std::max(stats.max[c], V);
+        }
+    }
+    stats.pixels += count;
+}
+
+SRegionStats CCaptureImage::regionStats(int x, int y, int w, int h, int level) {
+    SRegionStats stats;
+
+    level = std::clamp(level, 0, (int)m_vMips.size());
+
+    // in pixels of the level, a block only partly inside the rect counts whole
+    const int X0 = std::max(x, 0) >> level, Y0 = std::max(y, 0) >> level;
+    const int X1 = (std::min(x + w, m_iWidth) + (1 << level) - 1) >> level, Y1 = (std::min(y + h, m_iHeight) + (1 << level) - 1) >> level;
+
+    if (!m_pRaw || X0 >= X1 || Y0 >= Y1)
+        return stats;
+
+    // tile rows are contiguous, so every span handed to the reduction stays inside one tile
+    for (int ty = Y0 / TILE_SIZE; ty <= (Y1 - 1) / TILE_SIZE; ++ty) {
+        for (int tx = X0 / TILE_SIZE; tx <= (X1 - 1) / TILE_SIZE; ++tx) {
+            const uint32_t* TILE  = levelTile(level, tx, ty);
+            const int       FROMX = std::max(X0, tx * TILE_SIZE), TOX = std::min(X1, (tx + 1) * TILE_SIZE);
+            const int       FROMY = std::max(Y0, ty * TILE_SIZE), TOY = std::min(Y1, (ty + 1) * TILE_SIZE);
+
+            for (int sy = FROMY; sy < TOY; ++sy) {
+                const uint32_t* SPAN = TILE + (sy % TILE_SIZE) * TILE_SIZE + FROMX % TILE_SIZE;
+                if (m_bHighPrecision)
+                    accumulate10Bit(stats, SPAN, TOX - FROMX);
+                else
+                    accumulate8Bit(stats, SPAN, TOX - FROMX);
+            }
+        }
+    }
+
+    return stats;
+}
+
+SP<SPoolBuffer> CCaptureImage::raw() const {
+    return m_pRaw;
+}
+
+SRawView CCaptureImage::rawView() const {
+    if (!m_pRaw)
+        return {};
+
+    return {.origin = (const uint8_t*)m_pRaw->data + m_iOrigin,
+            .stepX  = m_iStepX,
+            .stepY  = m_iStepY,
+            .width  = m_iWidth,
+            .height = m_iHeight,
+            .format = m_pRaw->format,
+            .to8Bit = Formats::info(m_pRaw->format)->to8Bit};
+}
+
+uint64_t CCaptureImage::generation() const {
+    return m_iGeneration;
+}
+
+bool CCaptureImage::highPrecision() const {
+    return m_bHighPrecision;
+}
+
+cairo_format_t CCaptureImage::cairoFormat() const {
+    return m_bHighPrecision ? CAIRO_FORMAT_RGB30 : CAIRO_FORMAT_ARGB32;
+}
+
+Vector2D CCaptureImage::size() const {
+    return m_vSize;
+}
+
+cairo_surface_t* CCaptureImage::previewSurface() const {
+    return m_pPreviewSurface;
+}
+
+Vector2D CCaptureImage::previewSize() const {
+    return {(double)m_iPreviewWidth, (double)m_iPreviewHeight};
+}
+
+size_t CCaptureImage::convertedTiles() const {
+    return m_iConvertedTiles;
+}
+
+size_t CCaptureImage::committedBytes() const {
+    return m_iCommittedTiles * TILE_SIZE * TILE_SIZE * sizeof(uint32_t);
+}
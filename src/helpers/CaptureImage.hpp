@@ -0,0 +1,162 @@
+#pragma once
+
+#include "../defines.hpp"
+#include "PoolBuffer.hpp"
+#include "Formats.hpp"
+#include <array>
+
+// per channel statistics over a rect of image pixels, in the depth of the image (8 or 10 bits)
+struct SRegionStats {
+    size_t                  pixels = 0;
+    std::array<uint64_t, 3> sum    = {}; // r, g, b
+    std::array<uint16_t, 3> min    = {UINT16_MAX, UINT16_MAX, UINT16_MAX};
+    std::array<uint16_t, 3> max    = {};
+
+    double                  mean(int channel) const {
+        return pixels ? (double)sum[channel] / pixels : 0.0;
+    }
+};
+
+// the raw capture behind an image, in transformed space. Rows convert like the tiles do, for readers off the main thread
+struct SRawView {
+    const uint8_t*     origin = nullptr; // transformed 0, 0
+    ssize_t            stepX  = 0;       // bytes per pixel in x, may be negative
+    ssize_t            stepY  = 0;       // and per row
+    int                width  = 0;
+    int                height = 0;
+    uint32_t           format = 0;
+    Formats::ConvertFn to8Bit = nullptr;
+};
+
+// A captured output in its transformed orientation. Full resolution pixels live in TILE_SIZE square tiles which
+// are converted from the raw screencopy buffer the first time the lens touches them, the background is drawn
+// from a decimated preview built right after the capture. A minifying lens reads a mip pyramid on top of the tiles,
+// every level a 2x2 box reduction of the one below, with tiles just as lazy: a level tile is reduced from its four
+// children the first time it is read, so after a recapture only what a lens looks at is built again.
+// Pixels are ARGB8888, or XRGB2101010 for a high precision image of a capture with more than 8 bits per channel.
+class CCaptureImage {
+  public:
+    CCaptureImage(const Vector2D& size, const std::string& owner, bool highPrecision);
+    ~CCaptureImage();
+
+    static constexpr int TILE_SIZE          = 64;
+    static constexpr int PREVIEW_MAX_PIXELS = 2560 * 1440;
+    static constexpr int MIP_LEVELS         = 5; // full resolution and four reductions, enough for a scale of 8 with a level above it
+
+    // see Formats.hpp for the list
+    static bool supportsFormat(uint32_t format);
+    // more than 8 bits per channel
+    static bool isHighPrecisionFormat(uint32_t format);
+
+    // points the image at a new raw capture, drops every converted tile and rebuilds the preview
+    void setSource(SP<SPoolBuffer> raw, wl_output_transform transform);
+
+    // fills a w x h rect with the nearest pixel to srcOrigin + scale * (d + 0.5) for every pixel d from x0, y0 on,
+    // leaving pixels that fall outside the image untouched. dst points at the pixel for x0, y0
+    void             sampleNearest(uint32_t* dst, size_t dstStride, int x0, int y0, int w, int h, const Vector2D& srcOrigin, double scale);
+    // the same for scale > 1: every pixel blends bilinear samples of the two mip levels around log2(scale)
+    void             sampleTrilinear(uint32_t* dst, size_t dstStride, int x0, int y0, int w, int h, const Vector2D& srcOrigin, double scale);
+    // nearest for magnification, trilinear for minification
+    void             sample(uint32_t* dst, size_t dstStride, int x0, int y0, int w, int h, const Vector2D& srcOrigin, double scale);
+
+    // the image pixel at x, y, 0 outside of the image
+    uint32_t         pixel(int x, int y);
+    // converts every tile a rect of image pixels touches, rect clipped to the image, so other threads can read them.
+    // False without a capture to convert from
+    bool             prepare(int x, int y, int w, int h);
+    // row y of tile column tx, read only. The tile must be prepared
+    const uint32_t*  tileRow(int tx, int y) const;
+    // statistics of the image pixels in a rect, clipped to the image. A level above 0 reads that mip level instead, so a
+    // large rect costs a fraction of its pixels, min and max are then those of the 2^level square blocks
+    SRegionStats     regionStats(int x, int y, int w, int h, int level = 0);
+    // the mip level a scale reads from, 0 when magnifying
+    int              levelFor(double scale) const;
+
+    // nullptr without a source
+    SP<SPoolBuffer>  raw() const;
+    SRawView         rawView() const;
+
+    // changes with every setSource, never 0
+    uint64_t         generation() const;
+    bool             highPrecision() const;
+    cairo_format_t   cairoFormat() const;
+    Vector2D         size() const;
+    cairo_surface_t* previewSurface() const;
+    Vector2D         previewSize() const;
+    size_t           convertedTiles() const;
+    size_t           committedBytes() const;
+
+  private:
+    // level 1 and up of the mip pyramid, laid out like the full resolution tiles
+    struct SMipLevel {
+        uint32_t*            tiles  = nullptr;
+        size_t               bytes  = 0;
+        int                  width  = 0;
+        int                  height = 0;
+        int                  tilesX = 0;
+        int                  tilesY = 0;
+        std::vector<uint8_t> ready;
+        std::vector<uint8_t> committed;
+    };
+
+    const uint32_t* tile(int tx, int ty);
+    void            convertTile(int tx, int ty, uint32_t* out);
+    const uint32_t* levelTile(int level, int tx, int ty);
+    void            reduceTile(int level, int tx, int ty, uint32_t* out);
+    void            levelSpan(int level, int y, int from, int to, uint32_t* out);
+    int             levelWidth(int level) const;
+    int             levelHeight(int level) const;
+    int             levelTilesX(int level) const;
+    int             levelTilesY(int level) const;
+    void            buildPreview();
+    const uint8_t*  rawPixel(int x, int y) const;
+
+    Vector2D        m_vSize;
+    bool            m_bHighPrecision = false;
+    int             m_iWidth         = 0;
+    int             m_iHeight        = 0;
+
+    // tile-major anonymous mapping, pages only get committed for tiles that were converted
+    uint32_t*            m_pTiles      = nullptr;
+    size_t               m_iTilesBytes = 0;
+    int                  m_iTilesX     = 0;
+    int                  m_iTilesY     = 0;
+    std::vector<uint8_t> m_vTileReady;
+    std::vector<uint8_t> m_vTileCommitted;
+    size_t               m_iConvertedTiles = 0;
+    size_t               m_iCommittedTiles = 0; // of every level
+
+    // m_vMips[0] is level 1
+    std::vector<SMipLevel> m_vMips;
+
+    // bilinear taps of every column sampleTrilinear writes, per level it reads. Indices are relative to from, the
+    // span of level pixels a row needs runs from from to to
+    struct STaps {
+        int                   from = 0;
+        int                   to   = 0;
+        std::vector<int>      left;
+        std::vector<int>      right;
+        std::vector<uint32_t> weight;
+    };
+
+    std::array<STaps, 2>  m_aTaps;
+    std::vector<uint32_t> m_vSpanTop;
+    std::vector<uint32_t> m_vSpanBottom;
+    std::vector<uint32_t> m_vLevelRow; // the upper level, before it is blended into the lower one
+
+    std::string          m_szOwner;
+
+    SP<SPoolBuffer>      m_pRaw;
+    uint64_t             m_iGeneration = 0;
+    Formats::ConvertFn   m_pConvert    = nullptr;
+    // raw byte offset of the transformed origin and raw byte steps for +x and +y in transformed space
+    ssize_t               m_iOrigin = 0;
+    ssize_t               m_iStepX  = 0;
+    ssize_t               m_iStepY  = 0;
+
+    std::vector<uint32_t> m_vPreview;
+    cairo_surface_t*      m_pPreviewSurface = nullptr;
+    int                   m_iPreviewWidth   = 0;
+    int                   m_iPreviewHeight  = 0;
+    int                   m_iPreviewFactor  = 1;
+};
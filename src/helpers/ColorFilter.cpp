@@ -0,0 +1,297 @@
+#include "ColorFilter.hpp"
+
+#include <functional>
+#include <sstream>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using Matrix = std::array<double, 9>;
+
+static constexpr Matrix IDENTITY = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+
+static Matrix multiply(const Matrix& a, const Matrix& b) {
+    Matrix out = {};
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            out[r * 3 + c] = a[r * 3] * b[c] + a[r * 3 + 1] * b[3 + c] + a[r * 3 + 2] * b[6 + c];
+        }
+    }
+    return out;
+}
+
+// Machado et al. 2009 at full severity. They are meant for linear light and get applied to the encoded values here,
+// which is close enough to tell colours apart
+static constexpr Matrix SIM_PROTAN = {0.152286, 1.052583, -0.204868, 0.114503, 0.786281, 0.099216, -0.003882, -0.048116, 1.051998};
+static constexpr Matrix SIM_DEUTAN = {0.367322, 0.860646, -0.227968, 0.280085, 0.672501, 0.047413, -0.011820, 0.042940, 0.968881};
+static constexpr Matrix SIM_TRITAN = {1.255528, -0.076749, -0.178779, -0.078411, 0.930809, 0.147602, 0.004733, 0.691367, 0.303900};
+
+// daltonization, the colour the simulation loses is shifted into channels that are still seen: x + E (x - S x)
+static Matrix correction(const Matrix& simulation) {
+    static constexpr Matrix SHIFT = {0, 0, 0, 0.7, 1, 0, 0.7, 0, 1};
+
+    Matrix lost = {};
+    for (int i = 0; i < 9; ++i) {
+        lost[i] = IDENTITY[i] - simulation[i];
+    }
+
+    const auto SHIFTED = multiply(SHIFT, lost);
+
+    Matrix out = {};
+    for (int i = 0; i < 9; ++i) {
+        out[i] = IDENTITY[i] + SHIFTED[i];
+    }
+    return out;
+}
+
+CColorFilter::CColorFilter(const std::string& spec) : m_szSpec(spec) {
+    Matrix                                      matrix = IDENTITY;
+    std::vector<std::function<double(double)>> curve;
+    double                                      sharpen = 0.0;
+
+    std::istringstream                          iss(spec);
+    std::string                                 step;
+
+    while (std::getline(iss, step, ',')) {
+        const auto        COLON = step.find(':');
+        const std::string NAME  = step.substr(0, COLON);
+        double            arg   = 0.0;
+
+        if (NAME.empty())
+            continue;
+
+        if (COLON != std::string::npos) {
+            try {
+                arg = std::stod(step.substr(COLON + 1));
+            } catch (std::exception& e) { throw std::invalid_argument("bad argument in \"" + step + "\""); }
+        }
+
+        const auto ARG = [&](double fallback) { return COLON == std::string::npos ? fallback : arg; };
+
+        if (NAME == "invert")
+            curve.emplace_back([](double v) { return 1.0 - v; });
+        else if (NAME == "contrast") {
+            const double K = std::max(ARG(2.0), 0.0);
+            curve.emplace_back([K](double v) { return (v - 0.5) * K + 0.5; });
+        } else if (NAME == "gamma") {
+            const double G = std::max(ARG(1.8), 0.01);
+            curve.emplace_back([G](double v) { return std::pow(std::clamp(v, 0.0, 1.0), 1.0 / G); });
+        } else if (NAME == "greyscale" || NAME == "grayscale")
+            matrix = multiply({0.2126, 0.7152, 0.0722, 0.2126, 0.7152, 0.0722, 0.2126, 0.7152, 0.0722}, matrix);
+        else if (NAME == "sim-protan")
+            matrix = multiply(SIM_PROTAN, matrix);
+        else if (NAME == "sim-deutan")
+            matrix = multiply(SIM_DEUTAN, matrix);
+        else if (NAME == "sim-tritan")
+            matrix = multiply(SIM_TRITAN, matrix);
+        else if (NAME == "fix-protan")
+            matrix = multiply(correction(SIM_PROTAN), matrix);
+        else if (NAME == "fix-deutan")
+            matrix = multiply(correction(SIM_DEUTAN), matrix);
+        else if (NAME == "fix-tritan")
+            matrix = multiply(correction(SIM_TRITAN), matrix);
+        else if (NAME == "sharpen")
+            sharpen = std::clamp(ARG(1.0), 0.0, 8.0);
+        else
+            throw std::invalid_argument("unknown step \"" + NAME + "\"");
+    }
+
+    m_bMatrix = matrix != IDENTITY;
+    for (int i = 0; i < 9; ++i) {
+        m_aMatrix[i] = std::clamp<long>(std::lround(matrix[i] * 4096.0), INT16_MIN, INT16_MAX);
+    }
+
+    m_bCurve = !curve.empty();
+    if (m_bCurve) {
+        const auto EVAL = [&curve](double v) {
+            for (const auto& fn : curve) {
+                v = fn(v);
+            }
+            return std::clamp(v, 0.0, 1.0);
+        };
+
+        m_vCurve10Bit.resize(1024);
+        for (int i = 0; i < 256; ++i) {
+            m_aCurve8Bit[i] = std::lround(EVAL(i / 255.0) * 255.0);
+        }
+        for (int i = 0; i < 1024; ++i) {
+            m_vCurve10Bit[i] = std::lround(EVAL(i / 1023.0) * 1023.0);
+        }
+    }
+
+    // the blur below sums to 16x, so this is amount / 16 in Q13
+    m_iSharpen = std::lround(sharpen * 512.0);
+}
+
+const std::string& CColorFilter::spec() const {
+    return m_szSpec;
+}
+
+void CColorFilter::apply(uint32_t* data, size_t stride, int w, int h, bool highPrecision, bool reduced) {
+    if (w <= 0 || h <= 0)
+        return;
+
+    if (m_iSharpen && !reduced)
+        sharpen(data, stride, w, h, highPrecision);
+
+    if (!m_bMatrix && !m_bCurve)
+        return;
+
+    for (int y = 0; y < h; ++y) {
+        transform(data + y * stride, w, highPrecision);
+    }
+}
+
+// matrix then curve over a row
+void CColorFilter::transform(uint32_t* data, int count, bool highPrecision) const {
+    const auto& M = m_aMatrix;
+
+    if (highPrecision) {
+        for (int i = 0; i < count; ++i) {
+            const int R = (data[i] >> 20) & 0x3FF, G = (data[i] >> 10) & 0x3FF, B = data[i] & 0x3FF;
+            int       out[3] = {R, G, B};
+
+            if (m_bMatrix) {
+                for (int c = 0; c < 3; ++c) {
+                    out[c] = std::clamp((M[c * 3] * R + M[c * 3 + 1] * G + M[c * 3 + 2] * B + 2048) >> 12, 0, 1023);
+                }
+            }
+
+            if (m_bCurve) {
+                for (auto& v : out) {
+                    v = m_vCurve10Bit[v];
+                }
+            }
+
+            data[i] = 0xC0000000 | (out[0] << 20) | (out[1] << 10) | out[2];
+        }
+        return;
+    }
+
+    int i = 0;
+
+    if (m_bMatrix) {
+#if defined(__SSE2__)
+        // channels go to 16 bit lanes next to their partner, madd does two taps at once and the third comes with the rounding
+        const __m128i BYTE  = _mm_set1_epi32(0xFF);
+        const __m128i ALPHA = _mm_set1_epi32(0xFF000000);
+        const __m128i ONE   = _mm_set1_epi16(1);
+        const __m128i MAX   = _mm_set1_epi16(255);
+        const __m128i ZERO  = _mm_setzero_si128();
+
+        __m128i       rowRG[3], rowB1[3];
+        for (int c = 0; c < 3; ++c) {
+            rowRG[c] = _mm_set1_epi32((uint16_t)M[c * 3] | ((uint32_t)(uint16_t)M[c * 3 + 1] << 16));
+            rowB1[c] = _mm_set1_epi32((uint16_t)M[c * 3 + 2] | (2048u << 16));
+        }
+
+        for (; i + 4 <= count; i += 4) {
+            const __m128i PX = _mm_loadu_si128((const __m128i*)(data + i));
+            const __m128i R  = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(PX, 16), BYTE), ZERO);
+            const __m128i G  = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(PX, 8), BYTE), ZERO);
+            const __m128i B  = _mm_packs_epi32(_mm_and_si128(PX, BYTE), ZERO);
+            const __m128i RG = _mm_unpacklo_epi16(R, G);
+            const __m128i B1 = _mm_unpacklo_epi16(B, ONE);
+
+            __m128i       out = _mm_and_si128(PX, ALPHA);
+            for (int c = 0; c < 3; ++c) {
+                __m128i v = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(RG, rowRG[c]), _mm_madd_epi16(B1, rowB1[c])), 12);
+                v         = _mm_packs_epi32(v, v);
+                v         = _mm_unpacklo_epi16(_mm_min_epi16(_mm_max_epi16(v, ZERO), MAX), ZERO);
+                out       = _mm_or_si128(out, _mm_slli_epi32(v, 16 - c * 8));
+            }
+
+            _mm_storeu_si128((__m128i*)(data + i), out);
+        }
+#endif
+
+        for (int j = i; j < count; ++j) {
+            const int R = (data[j] >> 16) & 0xFF, G = (data[j] >> 8) & 0xFF, B = data[j] & 0xFF;
+            uint32_t  out = data[j] & 0xFF000000;
+            for (int c = 0; c < 3; ++c) {
+                out |= (uint32_t)std::clamp((M[c * 3] * R + M[c * 3 + 1] * G + M[c * 3 + 2] * B + 2048) >> 12, 0, 255) << (16 - c * 8);
+            }
+            data[j] = out;
+        }
+    }
+
+    if (m_bCurve) {
+        for (int j = 0; j < count; ++j) {
+            const uint32_t PX = data[j];
+            data[j]           = (PX & 0xFF000000) | (m_aCurve8Bit[(PX >> 16) & 0xFF] << 16) | (m_aCurve8Bit[(PX >> 8) & 0xFF] << 8) | m_aCurve8Bit[PX & 0xFF];
+        }
+    }
+}
+
+// unsharp mask against a 1 2 1 binomial blur, out = x + amount * (x - blur)
+void CColorFilter::sharpen(uint32_t* data, size_t stride, int w, int h, bool highPrecision) {
+    m_vSharpenSource.resize((size_t)w * h);
+    for (int y = 0; y < h; ++y) {
+        memcpy(&m_vSharpenSource[(size_t)y * w], data + y * stride, w * sizeof(uint32_t));
+    }
+
+    const uint32_t* SRC   = m_vSharpenSource.data();
+    const int       BITS  = highPrecision ? 10 : 8;
+    const int       MAX   = (1 << BITS) - 1;
+    const int       SHIFT = highPrecision ? 30 : 32; // channels below this get sharpened, 8 bit alpha too
+
+    const auto      pixel = [&](int x, int y) {
+        const int SX = std::clamp(x, 0, w - 1), SY = std::clamp(y, 0, h - 1);
+        return SRC[(size_t)SY * w + SX];
+    };
+
+    const auto scalar = [&](int x, int y) {
+        uint32_t out = highPrecision ? 0xC0000000 : 0;
+        for (int s = 0; s < SHIFT; s += BITS) {
+            const auto CH   = [&](int dx, int dy) { return (int)((pixel(x + dx, y + dy) >> s) & MAX); };
+            const int  BLUR = CH(-1, -1) + 2 * CH(0, -1) + CH(1, -1) + 2 * CH(-1, 0) + 4 * CH(0, 0) + 2 * CH(1, 0) + CH(-1, 1) + 2 * CH(0, 1) + CH(1, 1);
+            const int  V    = CH(0, 0) + (((CH(0, 0) * 16 - BLUR) * m_iSharpen) >> 13);
+            out |= (uint32_t)std::clamp(V, 0, MAX) << s;
+        }
+        data[y * stride + x] = out;
+    };
+
+    for (int y = 0; y < h; ++y) {
+        const bool EDGEROW = y == 0 || y == h - 1;
+        int        x       = 0;
+
+#if defined(__SSE2__)
+        if (!highPrecision && !EDGEROW && w > 2) {
+            scalar(0, y);
+            x = 1;
+
+            const __m128i ZERO = _mm_setzero_si128();
+            const __m128i K    = _mm_set1_epi16(m_iSharpen);
+
+            const auto    row = [&](const uint32_t* p, bool hi) {
+                const auto LOAD = [&](int dx) {
+                    const __m128i V = _mm_loadu_si128((const __m128i*)(p + dx));
+                    return hi ? _mm_unpackhi_epi8(V, ZERO) : _mm_unpacklo_epi8(V, ZERO);
+                };
+                return _mm_add_epi16(_mm_add_epi16(LOAD(-1), LOAD(1)), _mm_slli_epi16(LOAD(0), 1));
+            };
+
+            for (; x + 4 <= w - 1; x += 4) {
+                const uint32_t* A = SRC + (size_t)(y - 1) * w + x;
+                const uint32_t* B = SRC + (size_t)y * w + x;
+                const uint32_t* C = SRC + (size_t)(y + 1) * w + x;
+
+                __m128i         halves[2];
+                for (int hi = 0; hi < 2; ++hi) {
+                    const __m128i CENTER = hi ? _mm_unpackhi_epi8(_mm_loadu_si128((const __m128i*)B), ZERO) : _mm_unpacklo_epi8(_mm_loadu_si128((const __m128i*)B), ZERO);
+                    const __m128i BLUR   = _mm_add_epi16(_mm_add_epi16(row(A, hi), row(C, hi)), _mm_slli_epi16(row(B, hi), 1));
+                    const __m128i DIFF   = _mm_sub_epi16(_mm_slli_epi16(CENTER, 4), BLUR);
+                    halves[hi]           = _mm_add_epi16(CENTER, _mm_mulhi_epi16(_mm_slli_epi16(DIFF, 3), K));
+                }
+
+                _mm_storeu_si128((__m128i*)(data + y * stride + x), _mm_packus_epi16(halves[0], halves[1]));
+            }
+        }
+#endif
+
+        for (; x < w; ++x) {
+            scalar(x, y);
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../defines.hpp"
+#include <array>
+
+// A colour transform for the pixels of one lens, built from a comma separated spec like "fix-deutan,gamma:1.8,sharpen".
+// Whatever the spec order, the stages run as sharpen, then the 3x3 matrix, then the per-channel curve. Matrices and
+// curve steps compose in spec order within their stage.
+class CColorFilter {
+  public:
+    // throws std::invalid_argument naming the bad step
+    CColorFilter(const std::string& spec);
+
+    static constexpr const char* STEPS = "invert, greyscale, contrast[:K], gamma[:G], sim-protan, sim-deutan, sim-tritan, fix-protan, fix-deutan, fix-tritan, sharpen[:AMOUNT]";
+
+    // filters a w x h block of packed ARGB32, or XRGB2101010 for highPrecision, stride in pixels. reduced skips sharpen,
+    // the colour transform always runs since that is what a filter is for
+    void               apply(uint32_t* data, size_t stride, int w, int h, bool highPrecision, bool reduced = false);
+
+    const std::string& spec() const;
+
+  private:
+    void                      sharpen(uint32_t* data, size_t stride, int w, int h, bool highPrecision);
+    void                      transform(uint32_t* data, int count, bool highPrecision) const;
+
+    std::string               m_szSpec;
+
+    bool                      m_bMatrix = false;
+    std::array<int16_t, 9>    m_aMatrix = {}; // Q12, row major
+
+    bool                      m_bCurve = false;
+    std::array<uint8_t, 256>  m_aCurve8Bit;
+    std::vector<uint16_t>     m_vCurve10Bit;
+
+    int                       m_iSharpen = 0; // amount in Q13, 0 disables
+    std::vector<uint32_t>     m_vSharpenSource;
+};
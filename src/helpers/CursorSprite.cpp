@@ -0,0 +1,269 @@
+#include "CursorSprite.hpp"
+
+#include <format>
+#include <sstream>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+constexpr uint32_t XCURSOR_MAGIC = 0x72756358; // "Xcur"
+constexpr uint32_t XCURSOR_IMAGE = 0xFFFD0002;
+
+// the names theme authors use for it, then the arrow as a last resort
+constexpr const char* CURSOR_NAMES[] = {"crosshair", "cross", "tcross", "default", "left_ptr"};
+
+// what libXcursor searches without XCURSOR_PATH
+static std::vector<std::string> searchPath() {
+    std::string path = getenv("XCURSOR_PATH") ? getenv("XCURSOR_PATH") : "~/.local/share/icons:~/.icons:/usr/share/icons:/usr/share/pixmaps";
+    const auto  HOME = getenv("HOME");
+
+    std::vector<std::string> dirs;
+    size_t                   begin = 0;
+
+    while (begin <= path.size()) {
+        const size_t END = std::min(path.find(':', begin), path.size());
+        auto         dir = path.substr(begin, END - begin);
+        begin            = END + 1;
+
+        if (dir.starts_with("~")) {
+            if (!HOME)
+                continue;
+            dir = HOME + dir.substr(1);
+        }
+
+        if (!dir.empty())
+            dirs.push_back(dir);
+    }
+
+    return dirs;
+}
+
+CCursorSprite::CCursorSprite() {
+    const auto THEME = getenv("XCURSOR_THEME");
+
+    if ((!THEME || !loadTheme(THEME, 0)) && !loadTheme("default", 0)) {
+        Debug::log(LOG, "No cursor theme to draw the pointer from, drawing a crosshair");
+        drawFallback();
+    }
+}
+
+int CCursorSprite::nominalSize() {
+    const auto SIZE = getenv("XCURSOR_SIZE");
+    const int  PARSED = SIZE ? atoi(SIZE) : 0;
+    return PARSED > 0 ? PARSED : 24;
+}
+
+bool CCursorSprite::loadTheme(const std::string& theme, int depth) {
+    // themes inherit in chains, but never that long
+    if (depth > 8)
+        return false;
+
+    const auto DIRS = searchPath();
+
+    for (const auto NAME : CURSOR_NAMES) {
+        for (const auto& dir : DIRS) {
+            if (loadFile(std::format("{}/{}/cursors/{}", dir, theme, NAME)))
+                return true;
+        }
+    }
+
+    for (const auto& dir : DIRS) {
+        std::ifstream index(std::format("{}/{}/index.theme", dir, theme));
+        std::string   line;
+
+        while (std::getline(index, line)) {
+            if (!line.starts_with("Inherits"))
+                continue;
+
+            // Inherits=a,b;c
+            auto parents = line.substr(line.find('=') + 1);
+            std::ranges::replace(parents, ';', ',');
+
+            std::stringstream stream(parents);
+            std::string       parent;
+            while (std::getline(stream, parent, ',')) {
+                std::erase_if(parent, ::isspace);
+                if (!parent.empty() && parent != theme && loadTheme(parent, depth + 1))
+                    return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// every image chunk of the file, animations contribute their first frame per size
+bool CCursorSprite::loadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    const std::vector<uint8_t> DATA((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    const auto                 read32 = [&DATA](size_t offset, uint32_t& out) {
+        if (offset + 4 > DATA.size())
+            return false;
+        memcpy(&out, DATA.data() + offset, 4);
+        return true;
+    };
+
+    uint32_t magic = 0, headerSize = 0, tocEntries = 0;
+    if (!read32(0, magic) || magic != XCURSOR_MAGIC || !read32(4, headerSize) || !read32(12, tocEntries))
+        return false;
+
+    for (uint32_t i = 0; i < tocEntries; ++i) {
+        uint32_t type = 0, nominal = 0, position = 0;
+        if (!read32(headerSize + i * 12, type) || !read32(headerSize + i * 12 + 4, nominal) || !read32(headerSize + i * 12 + 8, position))
+            break;
+
+        if (type != XCURSOR_IMAGE || std::ranges::any_of(m_vSources, [nominal](const auto& s) { return s.size == (int)nominal; }))
+            continue;
+
+        // header, type, size, version, width, height, xhot, yhot, delay, then the pixels
+        uint32_t width = 0, height = 0, xhot = 0, yhot = 0;
+        if (!read32(position + 16, width) || !read32(position + 20, height) || !read32(position + 24, xhot) || !read32(position + 28, yhot))
+            continue;
+
+        if (!width || !height || width > 0x7FFF || height > 0x7FFF || position + 36 + (size_t)width * height * 4 > DATA.size())
+            continue;
+
+        // Xcursor pixels are premultiplied ARGB32 already
+        auto& image   = m_vSources.emplace_back();
+        image.size    = nominal;
+        image.width   = width;
+        image.height  = height;
+        image.hotspot = {(double)xhot, (double)yhot};
+        image.pixels.resize((size_t)width * height);
+        memcpy(image.pixels.data(), DATA.data() + position + 36, image.pixels.size() * 4);
+    }
+
+    if (m_vSources.empty())
+        return false;
+
+    std::ranges::sort(m_vSources, {}, &SImage::size);
+
+    Debug::log(LOG, "Drawing the pointer from %s (%zu sizes)", path.c_str(), m_vSources.size());
+    return true;
+}
+
+// white lines with a black outline, readable on anything
+void CCursorSprite::drawFallback() {
+    const int SIZE = nominalSize() | 1;
+    const int MID  = SIZE / 2;
+
+    auto&     image = m_vSources.emplace_back();
+    image.size      = SIZE;
+    image.width     = SIZE;
+    image.height    = SIZE;
+    image.hotspot   = {(double)MID, (double)MID};
+    image.pixels.assign((size_t)SIZE * SIZE, 0);
+
+    for (int i = 0; i < SIZE; ++i) {
+        for (int d = -1; d <= 1; ++d) {
+            const uint32_t COLOR = d ? 0xFF000000 : 0xFFFFFFFF;
+            if (MID + d < 0 || MID + d >= SIZE)
+                continue;
+
+            // the outline never overwrites the white of the other line
+            for (const auto INDEX : {(size_t)(MID + d) * SIZE + i, (size_t)i * SIZE + (MID + d)}) {
+                if (d == 0 || image.pixels[INDEX] != 0xFFFFFFFF)
+                    image.pixels[INDEX] = COLOR;
+            }
+        }
+    }
+}
+
+const CCursorSprite::SImage& CCursorSprite::scaled(int size) {
+    size = std::clamp((int)std::round(std::exp2(std::round(std::log2(std::max(size, 1)) * 2) / 2)), 1, MAX_SIZE);
+
+    for (const auto& image : m_vScaled) {
+        if (image.size == size)
+            return image;
+    }
+
+    // the smallest image at least that big, nearest neighbour keeps the hard pixel edges of everything else in the lens
+    const auto  IT     = std::ranges::find_if(m_vSources, [size](const auto& s) { return s.size >= size; });
+    const auto& SOURCE = IT == m_vSources.end() ? m_vSources.back() : *IT;
+    const auto  FACTOR = (double)size / SOURCE.size;
+
+    // sizes only change with the zoom, the oldest is the least likely to come back
+    if (m_vScaled.size() >= CACHED_SIZES)
+        m_vScaled.erase(m_vScaled.begin());
+
+    auto& image   = m_vScaled.emplace_back();
+    image.size    = size;
+    image.width   = std::max((int)std::round(SOURCE.width * FACTOR), 1);
+    image.height  = std::max((int)std::round(SOURCE.height * FACTOR), 1);
+    image.hotspot = SOURCE.hotspot * FACTOR;
+    image.pixels.resize((size_t)image.width * image.height);
+
+    for (int y = 0; y < image.height; ++y) {
+        const int SY = std::min((int)((y + 0.5) / FACTOR), SOURCE.height - 1);
+        for (int x = 0; x < image.width; ++x) {
+            const int SX                               = std::min((int)((x + 0.5) / FACTOR), SOURCE.width - 1);
+            image.pixels[(size_t)y * image.width + x] = SOURCE.pixels[(size_t)SY * SOURCE.width + SX];
+        }
+    }
+
+    return image;
+}
+
+// premultiplied over: dst * (255 - a) / 255 + sprite
+void CCursorSprite::blend(uint32_t* dst, const uint32_t* sprite, int count, bool highPrecision) {
+    int i = 0;
+
+    if (highPrecision) {
+        for (; i < count; ++i) {
+            const uint32_t PX  = sprite[i];
+            const uint32_t INV = 255 - (PX >> 24);
+            if (INV == 255)
+                continue;
+
+            uint32_t out = 0xC0000000;
+            for (int c = 0; c < 3; ++c) {
+                const uint32_t D = (dst[i] >> (c * 10)) & 0x3FF;
+                const uint32_t S = ((PX >> (c * 8)) & 0xFF) * 1023 / 255;
+                out |= std::min<uint32_t>(D * INV / 255 + S, 0x3FF) << (c * 10);
+            }
+            dst[i] = out;
+        }
+        return;
+    }
+
+#if defined(__SSE2__)
+    const __m128i ZERO = _mm_setzero_si128();
+    const __m128i HALF = _mm_set1_epi16(128);
+
+    const auto    div255 = [HALF](__m128i x) {
+        x = _mm_add_epi16(x, HALF);
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    };
+
+    for (; i + 4 <= count; i += 4) {
+        const __m128i S = _mm_loadu_si128((const __m128i*)(sprite + i));
+        const __m128i D = _mm_loadu_si128((const __m128i*)(dst + i));
+
+        // 255 - alpha of every pixel over its four channels
+        __m128i       inv = _mm_srli_epi32(S, 24);
+        inv               = _mm_or_si128(inv, _mm_slli_epi32(inv, 8));
+        inv               = _mm_xor_si128(_mm_or_si128(inv, _mm_slli_epi32(inv, 16)), _mm_set1_epi8((char)0xFF));
+
+        const __m128i LO = div255(_mm_mullo_epi16(_mm_unpacklo_epi8(D, ZERO), _mm_unpacklo_epi8(inv, ZERO)));
+        const __m128i HI = div255(_mm_mullo_epi16(_mm_unpackhi_epi8(D, ZERO), _mm_unpackhi_epi8(inv, ZERO)));
+
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_adds_epu8(_mm_packus_epi16(LO, HI), S));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        const uint32_t PX  = sprite[i];
+        const uint32_t INV = 255 - (PX >> 24);
+
+        uint32_t       out = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            const uint32_t D = (dst[i] >> shift) & 0xFF;
+            out |= std::min<uint32_t>((D * INV + 127) / 255 + ((PX >> shift) & 0xFF), 255) << shift;
+        }
+        dst[i] = out;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../defines.hpp"
+
+// The pointer as the lens shows it. The crosshair of the cursor theme (the shape the magnifier sets on its surfaces) is
+// decoded from its Xcursor file once, every size it gets drawn at is scaled from the closest image and kept around.
+// libwayland-cursor only hands out wl_buffers of its images, so the theme is read the way it reads it: XCURSOR_PATH,
+// XCURSOR_THEME and XCURSOR_SIZE, following Inherits= in index.theme.
+class CCursorSprite {
+  public:
+    // a drawn crosshair if the theme has no cursor to offer
+    CCursorSprite();
+
+    // premultiplied ARGB32
+    struct SImage {
+        int                   size   = 0; // nominal, the height it was asked for
+        int                   width  = 0;
+        int                   height = 0;
+        Vector2D              hotspot;
+        std::vector<uint32_t> pixels;
+    };
+
+    static constexpr size_t CACHED_SIZES = 8;
+    static constexpr int    MAX_SIZE     = 1024;
+
+    // XCURSOR_SIZE, 24 without it
+    static int              nominalSize();
+
+    // the sprite at size pixels rounded to a power of sqrt(2), clamped to MAX_SIZE. A continuous zoom asks for a new
+    // size every step, rounded it keeps landing on the few the cache holds
+    const SImage&           scaled(int size);
+
+    // composites count sprite pixels over dst, packed ARGB32 or XRGB2101010 for highPrecision
+    static void             blend(uint32_t* dst, const uint32_t* sprite, int count, bool highPrecision);
+
+  private:
+    bool                loadTheme(const std::string& theme, int depth);
+    bool                loadFile(const std::string& path);
+    void                drawFallback();
+
+    std::vector<SImage> m_vSources; // as decoded, one per nominal size in the file
+    std::vector<SImage> m_vScaled;  // oldest first
+};
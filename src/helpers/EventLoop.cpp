@@ -0,0 +1,230 @@
+#include "EventLoop.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+CEventLoop::CEventLoop() {
+    m_iEpollFD = epoll_create1(EPOLL_CLOEXEC);
+    m_iEventFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    if (m_iEpollFD < 0 || m_iEventFD < 0) {
+        Debug::log(CRIT, "Failed to create the event loop");
+        exit(1);
+    }
+
+    sigemptyset(&m_sSignals);
+
+    addFd(m_iEventFD, [this]() { onWakeup(); });
+}
+
+CEventLoop::~CEventLoop() {
+    for (const auto FD : m_sTimers) {
+        close(FD);
+    }
+
+    if (m_iSignalFD >= 0)
+        close(m_iSignalFD);
+
+    close(m_iEventFD);
+    close(m_iEpollFD);
+}
+
+void CEventLoop::addFd(int fd, std::function<void()> onReadable) {
+    epoll_event ev = {.events = EPOLLIN, .data = {.fd = fd}};
+
+    if (epoll_ctl(m_iEpollFD, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        Debug::log(ERR, "Failed to add fd %d to the event loop", fd);
+        return;
+    }
+
+    m_mSources[fd] = onReadable;
+}
+
+// the caller keeps ownership of fd
+void CEventLoop::removeFd(int fd) {
+    epoll_ctl(m_iEpollFD, EPOLL_CTL_DEL, fd, nullptr);
+    m_mSources.erase(fd);
+}
+
+int CEventLoop::addTimer(uint64_t ms, uint64_t intervalMs, std::function<void()> onTimeout) {
+    const int FD = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+
+    if (FD < 0) {
+        Debug::log(ERR, "Failed to create a timerfd");
+        return -1;
+    }
+
+    addFd(FD, [FD, onTimeout]() {
+        uint64_t expirations = 0;
+        if (read(FD, &expirations, sizeof(expirations)) == sizeof(expirations))
+            onTimeout();
+    });
+
+    m_sTimers.insert(FD);
+
+    updateTimer(FD, ms, intervalMs);
+
+    return FD;
+}
+
+static timespec msToTimespec(uint64_t ms) {
+    return {.tv_sec = (time_t)(ms / 1000), .tv_nsec = (long)(ms % 1000) * 1000000L};
+}
+
+void CEventLoop::updateTimer(int timer, uint64_t ms, uint64_t intervalMs) {
+    if (timer < 0)
+        return;
+
+    const itimerspec SPEC = {.it_interval = msToTimespec(intervalMs), .it_value = msToTimespec(ms)};
+
+    timerfd_settime(timer, 0, &SPEC, nullptr);
+}
+
+void CEventLoop::removeTimer(int timer) {
+    if (timer < 0)
+        return;
+
+    removeFd(timer);
+    m_sTimers.erase(timer);
+    close(timer);
+}
+
+void CEventLoop::addSignal(int sig, std::function<void()> onSignal) {
+    sigaddset(&m_sSignals, sig);
+
+    if (sigprocmask(SIG_BLOCK, &m_sSignals, nullptr) < 0) {
+        Debug::log(ERR, "Failed to block signal %d", sig);
+        return;
+    }
+
+    const bool NEWFD = m_iSignalFD < 0;
+
+    m_iSignalFD = signalfd(m_iSignalFD, &m_sSignals, SFD_CLOEXEC | SFD_NONBLOCK);
+
+    if (m_iSignalFD < 0) {
+        Debug::log(ERR, "Failed to create a signalfd");
+        return;
+    }
+
+    if (NEWFD)
+        addFd(m_iSignalFD, [this]() { onSignalFd(); });
+
+    m_mSignalHandlers[sig] = onSignal;
+}
+
+void CEventLoop::doLater(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lg(m_mtQueue);
+        m_vQueue.emplace_back(std::move(fn));
+    }
+
+    const uint64_t ONE = 1;
+    if (write(m_iEventFD, &ONE, sizeof(ONE)) < 0)
+        Debug::log(ERR, "Failed to wake the event loop");
+}
+
+void CEventLoop::onWakeup() {
+    uint64_t count = 0;
+    if (read(m_iEventFD, &count, sizeof(count)) < 0)
+        return;
+
+    std::vector<std::function<void()>> queue;
+    {
+        std::lock_guard<std::mutex> lg(m_mtQueue);
+        queue.swap(m_vQueue);
+    }
+
+    for (auto& fn : queue) {
+        fn();
+    }
+}
+
+void CEventLoop::onSignalFd() {
+    signalfd_siginfo info;
+
+    while (read(m_iSignalFD, &info, sizeof(info)) == sizeof(info)) {
+        const auto IT = m_mSignalHandlers.find(info.ssi_signo);
+        if (IT != m_mSignalHandlers.end())
+            IT->second();
+    }
+}
+
+void CEventLoop::dispatch(int fd) {
+    const auto IT = m_mSources.find(fd);
+    if (IT == m_mSources.end())
+        return;
+
+    // copied, the callback may remove its own source
+    const auto FN = IT->second;
+    FN();
+}
+
+void CEventLoop::run(wl_display* display) {
+    const int WLFD = wl_display_get_fd(display);
+
+    epoll_event ev = {.events = EPOLLIN, .data = {.fd = WLFD}};
+    epoll_ctl(m_iEpollFD, EPOLL_CTL_ADD, WLFD, &ev);
+
+    epoll_event events[32];
+
+    while (m_bRunning) {
+        while (wl_display_prepare_read(display) != 0) {
+            if (wl_display_dispatch_pending(display) < 0) {
+                Debug::log(ERR, "Wayland connection lost");
+                return;
+            }
+        }
+
+        wl_display_flush(display);
+
+        const int COUNT = epoll_wait(m_iEpollFD, events, 32, -1);
+
+        if (COUNT < 0) {
+            wl_display_cancel_read(display);
+            if (errno == EINTR)
+                continue;
+            Debug::log(ERR, "epoll_wait failed: %d", errno);
+            break;
+        }
+
+        bool wlReady = false;
+        for (int i = 0; i < COUNT; ++i) {
+            if (events[i].data.fd != WLFD)
+                continue;
+
+            wlReady = true;
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+                m_bRunning = false;
+        }
+
+        if (wlReady) {
+            if (wl_display_read_events(display) < 0) {
+                Debug::log(ERR, "Wayland connection lost");
+                break;
+            }
+        } else
+            wl_display_cancel_read(display);
+
+        if (wl_display_dispatch_pending(display) < 0) {
+            Debug::log(ERR, "Wayland connection lost");
+            break;
+        }
+
+        for (int i = 0; i < COUNT && m_bRunning; ++i) {
+            if (events[i].data.fd != WLFD)
+                dispatch(events[i].data.fd);
+        }
+    }
+
+    epoll_ctl(m_iEpollFD, EPOLL_CTL_DEL, WLFD, nullptr);
+}
+
+void CEventLoop::stop() {
+    m_bRunning = false;
+}
+
+bool CEventLoop::running() const {
+    return m_bRunning;
+}
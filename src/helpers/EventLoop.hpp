@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../defines.hpp"
+#include <functional>
+#include <mutex>
+#include <csignal>
+#include <unordered_set>
+
+// epoll loop driving the wayland connection together with plain fds, timerfds,
+// signalfd and an eventfd that worker threads use to hand work back to the main thread.
+class CEventLoop {
+  public:
+    CEventLoop();
+    ~CEventLoop();
+
+    void addFd(int fd, std::function<void()> onReadable);
+    void removeFd(int fd);
+
+    // returns a timer id. Fires after ms, then every intervalMs if that is set, ms == 0 disarms
+    int  addTimer(uint64_t ms, uint64_t intervalMs, std::function<void()> onTimeout);
+    void updateTimer(int timer, uint64_t ms, uint64_t intervalMs = 0);
+    void removeTimer(int timer);
+
+    // blocks the signal, so this has to run before any thread is spawned
+    void addSignal(int sig, std::function<void()> onSignal);
+
+    // thread safe, fn runs on the loop thread
+    void doLater(std::function<void()> fn);
+
+    void run(wl_display* display);
+    void stop();
+    bool running() const;
+
+  private:
+    void                                           dispatch(int fd);
+    void                                           onWakeup();
+    void                                           onSignalFd();
+
+    int                                            m_iEpollFD  = -1;
+    int                                            m_iEventFD  = -1;
+    int                                            m_iSignalFD = -1;
+    sigset_t                                       m_sSignals;
+
+    std::unordered_map<int, std::function<void()>> m_mSources;
+    std::unordered_map<int, std::function<void()>> m_mSignalHandlers;
+    std::unordered_set<int>                        m_sTimers;
+
+    std::mutex                                     m_mtQueue;
+    std::vector<std::function<void()>>             m_vQueue;
+
+    bool                                           m_bRunning = true;
+};
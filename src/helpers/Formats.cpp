@@ -0,0 +1,37 @@
+#include "Formats.hpp"
+
+namespace Formats {
+    template <typename F>
+    constexpr SFormatInfo entry() {
+        return {F::FORMAT, F::BYTES, F::BITS, convertSpan<F, Dst8Bit>, convertSpan<F, Dst10Bit>};
+    }
+
+    static constexpr SFormatInfo FORMATS[] = {
+        entry<FmtARGB8888>(),      entry<FmtXRGB8888>(),      entry<FmtABGR8888>(),      entry<FmtXBGR8888>(),      entry<FmtRGBA8888>(),
+        entry<FmtRGBX8888>(),      entry<FmtBGRA8888>(),      entry<FmtBGRX8888>(),      entry<FmtRGB888>(),        entry<FmtBGR888>(),
+        entry<FmtRGB565>(),        entry<FmtBGR565>(),        entry<FmtARGB1555>(),      entry<FmtXRGB1555>(),      entry<FmtARGB2101010>(),
+        entry<FmtXRGB2101010>(),   entry<FmtABGR2101010>(),   entry<FmtXBGR2101010>(),   entry<FmtRGBA1010102>(),   entry<FmtRGBX1010102>(),
+        entry<FmtBGRA1010102>(),   entry<FmtBGRX1010102>(),   entry<FmtARGB16161616>(),  entry<FmtXRGB16161616>(),  entry<FmtABGR16161616>(),
+        entry<FmtXBGR16161616>(),  entry<FmtARGB16161616F>(), entry<FmtXRGB16161616F>(), entry<FmtABGR16161616F>(), entry<FmtXBGR16161616F>(),
+    };
+
+    const SFormatInfo* info(uint32_t format) {
+        for (const auto& f : FORMATS) {
+            if (f.format == format)
+                return &f;
+        }
+
+        return nullptr;
+    }
+
+    uint32_t fromDRM(uint32_t fourcc) {
+        constexpr uint32_t DRM_ARGB8888 = 0x34325241; // AR24
+        constexpr uint32_t DRM_XRGB8888 = 0x34325258; // XR24
+
+        switch (fourcc) {
+            case DRM_ARGB8888: return WL_SHM_FORMAT_ARGB8888;
+            case DRM_XRGB8888: return WL_SHM_FORMAT_XRGB8888;
+            default: return fourcc;
+        }
+    }
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "../defines.hpp"
+#include <bit>
+
+// Compile-time descriptions of the wl_shm formats a capture can arrive in. Every (source, destination) pair
+// instantiates its own converter, so the ingest loops never branch on the format per pixel.
+
+struct SChannel {
+    int shift = 0;
+    int bits  = 0; // 0 if the format lacks the channel
+};
+
+template <uint32_t FORMAT_, int BYTES_, SChannel R_, SChannel G_, SChannel B_, SChannel A_ = SChannel{}, bool FLOAT_ = false>
+struct SFormat {
+    static constexpr uint32_t FORMAT    = FORMAT_;
+    static constexpr int      BYTES     = BYTES_;
+    static constexpr SChannel R         = R_;
+    static constexpr SChannel G         = G_;
+    static constexpr SChannel B         = B_;
+    static constexpr SChannel A         = A_;
+    static constexpr bool     FLOAT     = FLOAT_; // channels are IEEE half floats
+    static constexpr int      BITS      = FLOAT ? 16 : std::max({R.bits, G.bits, B.bits});
+    static constexpr bool     HAS_ALPHA = A.bits > 0;
+
+    using Word                          = std::conditional_t<(BYTES > 4), uint64_t, uint32_t>;
+};
+
+// clang-format off
+using FmtARGB8888      = SFormat<WL_SHM_FORMAT_ARGB8888, 4, {16, 8}, {8, 8}, {0, 8}, {24, 8}>;
+using FmtXRGB8888      = SFormat<WL_SHM_FORMAT_XRGB8888, 4, {16, 8}, {8, 8}, {0, 8}>;
+using FmtABGR8888      = SFormat<WL_SHM_FORMAT_ABGR8888, 4, {0, 8}, {8, 8}, {16, 8}, {24, 8}>;
+using FmtXBGR8888      = SFormat<WL_SHM_FORMAT_XBGR8888, 4, {0, 8}, {8, 8}, {16, 8}>;
+using FmtRGBA8888      = SFormat<WL_SHM_FORMAT_RGBA8888, 4, {24, 8}, {16, 8}, {8, 8}, {0, 8}>;
+using FmtRGBX8888      = SFormat<WL_SHM_FORMAT_RGBX8888, 4, {24, 8}, {16, 8}, {8, 8}>;
+using FmtBGRA8888      = SFormat<WL_SHM_FORMAT_BGRA8888, 4, {8, 8}, {16, 8}, {24, 8}, {0, 8}>;
+using FmtBGRX8888      = SFormat<WL_SHM_FORMAT_BGRX8888, 4, {8, 8}, {16, 8}, {24, 8}>;
+using FmtRGB888        = SFormat<WL_SHM_FORMAT_RGB888, 3, {16, 8}, {8, 8}, {0, 8}>;
+using FmtBGR888        = SFormat<WL_SHM_FORMAT_BGR888, 3, {0, 8}, {8, 8}, {16, 8}>;
+using FmtRGB565        = SFormat<WL_SHM_FORMAT_RGB565, 2, {11, 5}, {5, 6}, {0, 5}>;
+using FmtBGR565        = SFormat<WL_SHM_FORMAT_BGR565, 2, {0, 5}, {5, 6}, {11, 5}>;
+using FmtARGB1555      = SFormat<WL_SHM_FORMAT_ARGB1555, 2, {10, 5}, {5, 5}, {0, 5}, {15, 1}>;
+using FmtXRGB1555      = SFormat<WL_SHM_FORMAT_XRGB1555, 2, {10, 5}, {5, 5}, {0, 5}>;
+using FmtARGB2101010   = SFormat<WL_SHM_FORMAT_ARGB2101010, 4, {20, 10}, {10, 10}, {0, 10}, {30, 2}>;
+using FmtXRGB2101010   = SFormat<WL_SHM_FORMAT_XRGB2101010, 4, {20, 10}, {10, 10}, {0, 10}>;
+using FmtABGR2101010   = SFormat<WL_SHM_FORMAT_ABGR2101010, 4, {0, 10}, {10, 10}, {20, 10}, {30, 2}>;
+using FmtXBGR2101010   = SFormat<WL_SHM_FORMAT_XBGR2101010, 4, {0, 10}, {10, 10}, {20, 10}>;
+using FmtRGBA1010102   = SFormat<WL_SHM_FORMAT_RGBA1010102, 4, {22, 10}, {12, 10}, {2, 10}, {0, 2}>;
+using FmtRGBX1010102   = SFormat<WL_SHM_FORMAT_RGBX1010102, 4, {22, 10}, {12, 10}, {2, 10}>;
+using FmtBGRA1010102   = SFormat<WL_SHM_FORMAT_BGRA1010102, 4, {2, 10}, {12, 10}, {22, 10}, {0, 2}>;
+using FmtBGRX1010102   = SFormat<WL_SHM_FORMAT_BGRX1010102, 4, {2, 10}, {12, 10}, {22, 10}>;
+using FmtARGB16161616  = SFormat<WL_SHM_FORMAT_ARGB16161616, 8, {32, 16}, {16, 16}, {0, 16}, {48, 16}>;
+using FmtXRGB16161616  = SFormat<WL_SHM_FORMAT_XRGB16161616, 8, {32, 16}, {16, 16}, {0, 16}>;
+using FmtABGR16161616  = SFormat<WL_SHM_FORMAT_ABGR16161616, 8, {0, 16}, {16, 16}, {32, 16}, {48, 16}>;
+using FmtXBGR16161616  = SFormat<WL_SHM_FORMAT_XBGR16161616, 8, {0, 16}, {16, 16}, {32, 16}>;
+using FmtARGB16161616F = SFormat<WL_SHM_FORMAT_ARGB16161616F, 8, {32, 16}, {16, 16}, {0, 16}, {48, 16}, true>;
+using FmtXRGB16161616F = SFormat<WL_SHM_FORMAT_XRGB16161616F, 8, {32, 16}, {16, 16}, {0, 16}, {}, true>;
+using FmtABGR16161616F = SFormat<WL_SHM_FORMAT_ABGR16161616F, 8, {0, 16}, {16, 16}, {32, 16}, {48, 16}, true>;
+using FmtXBGR16161616F = SFormat<WL_SHM_FORMAT_XBGR16161616F, 8, {0, 16}, {16, 16}, {32, 16}, {}, true>;
+// clang-format on
+
+namespace Formats {
+    template <typename F>
+    inline typename F::Word load(const uint8_t* px) {
+        if constexpr (F::BYTES == 3)
+            return px[0] | (px[1] << 8) | (px[2] << 16);
+        else if constexpr (F::BYTES == 2) {
+            uint16_t word = 0;
+            memcpy(&word, px, sizeof(word));
+            return word;
+        } else {
+            typename F::Word word = 0;
+            memcpy(&word, px, sizeof(word));
+            return word;
+        }
+    }
+
+    // denormals flush to zero, nothing on a screen is that dark
+    inline float halfToFloat(uint32_t h) {
+        const uint32_t EXP  = (h >> 10) & 0x1F;
+        const uint32_t BITS = ((h & 0x8000) << 16) | ((EXP + 112) << 23) | ((h & 0x3FF) << 13);
+        return EXP ? std::bit_cast<float>(BITS) : 0.F;
+    }
+
+    // reads channel C of a source word at TO bits, rounding to nearest
+    template <typename F, SChannel C, int TO>
+    inline uint32_t channel(typename F::Word word) {
+        constexpr uint32_t DSTMAX = (1u << TO) - 1;
+
+        if constexpr (C.bits == 0)
+            return DSTMAX;
+        else if constexpr (F::FLOAT)
+            return (uint32_t)(std::clamp(halfToFloat((word >> C.shift) & 0xFFFF), 0.F, 1.F) * DSTMAX + 0.5F);
+        else {
+            constexpr uint32_t SRCMAX = (1u << C.bits) - 1;
+            const uint32_t     V      = (word >> C.shift) & SRCMAX;
+
+            if constexpr (C.bits == TO)
+                return V;
+            else
+                return (V * DSTMAX + SRCMAX / 2) / SRCMAX;
+        }
+    }
+
+    template <typename SRC, typename DST>
+    inline uint32_t convertPixel(const uint8_t* px) {
+        const auto WORD = load<SRC>(px);
+
+        return (channel<SRC, SRC::R, DST::R.bits>(WORD) << DST::R.shift) | (channel<SRC, SRC::G, DST::G.bits>(WORD) << DST::G.shift) |
+            (channel<SRC, SRC::B, DST::B.bits>(WORD) << DST::B.shift) | (channel<SRC, SRC::A, DST::A.bits>(WORD) << DST::A.shift);
+    }
+
+    // converts count pixels that are step bytes apart in the source into a packed destination row
+    template <typename SRC, typename DST>
+    void convertSpan(const uint8_t* src, ssize_t step, uint32_t* dst, int count) {
+        for (int i = 0; i < count; ++i) {
+            dst[i] = convertPixel<SRC, DST>(src);
+            src += step;
+        }
+    }
+
+    // destinations, the padding bits of the 10-bit one are written as opaque
+    using Dst8Bit  = FmtARGB8888;
+    using Dst10Bit = SFormat<WL_SHM_FORMAT_XRGB2101010, 4, {20, 10}, {10, 10}, {0, 10}, {30, 2}>;
+
+    using ConvertFn = void (*)(const uint8_t* src, ssize_t step, uint32_t* dst, int count);
+
+    struct SFormatInfo {
+        uint32_t  format = 0;
+        int       bytes  = 0;
+        int       bits   = 0;
+        ConvertFn to8Bit  = nullptr;
+        ConvertFn to10Bit = nullptr;
+    };
+
+    // nullptr for formats hyprmagnifier can't read
+    const SFormatInfo* info(uint32_t format);
+
+    // the wl_shm format of a DRM fourcc, they only differ for the two 8888 formats every compositor has
+    uint32_t           fromDRM(uint32_t fourcc);
+};
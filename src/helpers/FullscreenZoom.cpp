@@ -0,0 +1,184 @@
+#include "FullscreenZoom.hpp"
+
+CFullscreenZoom::CFullscreenZoom() {
+    const int THREADS = std::clamp((int)std::thread::hardware_concurrency(), 1, 8);
+
+    for (int i = 1; i < THREADS; ++i) {
+        m_vWorkers.emplace_back([this]() {
+            uint64_t seen = 0;
+
+            while (true) {
+                std::unique_lock lock(m_mtJob);
+                m_cvJob.wait(lock, [this, &seen]() { return m_bExit || m_iJobSerial != seen; });
+
+                if (m_bExit)
+                    return;
+
+                seen             = m_iJobSerial;
+                const auto BANDS = m_iBands;
+                const auto JOB   = m_pJob;
+                lock.unlock();
+
+                runBands(seen, BANDS, JOB);
+            }
+        });
+    }
+}
+
+CFullscreenZoom::~CFullscreenZoom() {
+    {
+        std::lock_guard lock(m_mtJob);
+        m_bExit = true;
+    }
+    m_cvJob.notify_all();
+
+    for (auto& worker : m_vWorkers) {
+        worker.join();
+    }
+}
+
+SZoomView CFullscreenZoom::viewFor(const Vector2D& pointer, const Vector2D& pointerBuffer, double scale, const Vector2D& imageSize, const Vector2D& bufferSize) {
+    // at most the whole image across the buffer
+    scale = std::min({scale, imageSize.x / bufferSize.x, imageSize.y / bufferSize.y});
+
+    // snapped to whole buffer pixels, less than half a buffer pixel off the pointer
+    const auto    MAX  = (imageSize / scale - bufferSize).floor();
+    const int64_t MAXX = std::max(MAX.x, 0.0), MAXY = std::max(MAX.y, 0.0);
+
+    return {.originX = std::clamp((int64_t)std::round(pointer.x / scale - pointerBuffer.x), (int64_t)0, MAXX),
+            .originY = std::clamp((int64_t)std::round(pointer.y / scale - pointerBuffer.y), (int64_t)0, MAXY),
+            .scale   = scale};
+}
+
+bool CFullscreenZoom::render(SPoolBuffer* buffer, CCaptureImage* image, const SPoolBuffer* previous, const SZoomView& view) {
+    const int  WIDTH  = buffer->pixelSize.x;
+    const int  HEIGHT = buffer->pixelSize.y;
+    const auto SIZE   = image->size();
+
+    if (WIDTH <= 0 || HEIGHT <= 0 || view.scale <= 0)
+        return false;
+
+    m_vColumns.resize(WIDTH);
+    m_vRows.resize(HEIGHT);
+
+    for (int x = 0; x < WIDTH; ++x) {
+        m_vColumns[x] = std::clamp((int)std::floor((view.originX + x + 0.5) * view.scale), 0, (int)SIZE.x - 1);
+    }
+    for (int y = 0; y < HEIGHT; ++y) {
+        m_vRows[y] = std::clamp((int)std::floor((view.originY + y + 0.5) * view.scale), 0, (int)SIZE.y - 1);
+    }
+
+    // the bands only read tiles, whatever they need is converted here
+    if (!image->prepare(m_vColumns.front(), m_vRows.front(), m_vColumns.back() - m_vColumns.front() + 1, m_vRows.back() - m_vRows.front() + 1))
+        return false;
+
+    // whole buffer pixels apart at the same scale, so buffer pixel x, y now shows what x + dx, y + dy did then
+    const bool SHIFT = previous && previous->drawn.zoom.scale == view.scale;
+    m_iShiftX        = SHIFT ? view.originX - previous->drawn.zoom.originX : 0;
+    m_iShiftY        = SHIFT ? view.originY - previous->drawn.zoom.originY : 0;
+    m_iKeptX0        = SHIFT ? std::clamp(-m_iShiftX, 0, WIDTH) : 0;
+    m_iKeptX1        = SHIFT ? std::clamp(WIDTH - m_iShiftX, m_iKeptX0, WIDTH) : 0;
+    m_iKeptY0        = SHIFT ? std::clamp(-m_iShiftY, 0, HEIGHT) : 0;
+    m_iKeptY1        = SHIFT ? std::clamp(HEIGHT - m_iShiftY, m_iKeptY0, HEIGHT) : 0;
+
+    // a few bands per thread, so one that hits more duplicate rows doesn't leave the others waiting
+    const int BANDS = std::clamp(HEIGHT / 16, 1, (int)(m_vWorkers.size() + 1) * 4);
+
+    if (m_vLines.size() < (size_t)BANDS)
+        m_vLines.resize(BANDS);
+
+    parallel(BANDS, [&](int band) {
+        renderBand((uint32_t*)buffer->data, SHIFT ? (const uint32_t*)previous->data : nullptr, WIDTH, image, HEIGHT * band / BANDS, HEIGHT * (band + 1) / BANDS, m_vLines[band]);
+    });
+
+    return true;
+}
+
+void CFullscreenZoom::renderBand(uint32_t* pixels, const uint32_t* previous, int width, CCaptureImage* image, int y0, int y1, std::vector<uint32_t>& line) {
+    for (int y = y0; y < y1; ++y) {
+        uint32_t* row = pixels + (size_t)y * width;
+
+        // a magnified row repeats the one above most of the time
+        if (y > y0 && m_vRows[y] == m_vRows[y - 1]) {
+            memcpy(row, row - width, width * sizeof(uint32_t));
+            continue;
+        }
+
+        if (!previous || y < m_iKeptY0 || y >= m_iKeptY1 || m_iKeptX0 >= m_iKeptX1) {
+            gather(row, image, m_vRows[y], 0, width, line);
+            continue;
+        }
+
+        // what the last frame had, and the columns on either side of it that came into view
+        memcpy(row + m_iKeptX0, previous + (size_t)(y + m_iShiftY) * width + m_iKeptX0 + m_iShiftX, (m_iKeptX1 - m_iKeptX0) * sizeof(uint32_t));
+        gather(row, image, m_vRows[y], 0, m_iKeptX0, line);
+        gather(row, image, m_vRows[y], m_iKeptX1, width, line);
+    }
+}
+
+// buffer columns x0 to x1 of a row out of source row sy
+void CFullscreenZoom::gather(uint32_t* row, CCaptureImage* image, int sy, int x0, int x1, std::vector<uint32_t>& line) {
+    constexpr int TILE = CCaptureImage::TILE_SIZE;
+
+    if (x0 >= x1)
+        return;
+
+    // columns only ever go right, so the first and last one bound the source span
+    const int SX0 = m_vColumns[x0];
+    const int SX1 = m_vColumns[x1 - 1] + 1;
+
+    line.resize(SX1 - SX0);
+
+    // the span out of its tiles into one line, then the columns gather from that
+    for (int tx = SX0 / TILE; tx <= (SX1 - 1) / TILE; ++tx) {
+        const int FROM = std::max(SX0, tx * TILE);
+        const int TO   = std::min(SX1, (tx + 1) * TILE);
+        memcpy(line.data() + (FROM - SX0), image->tileRow(tx, sy) + (FROM - tx * TILE), (TO - FROM) * sizeof(uint32_t));
+    }
+
+    const uint32_t* LINE = line.data() - SX0;
+    for (int x = x0; x < x1; ++x) {
+        row[x] = LINE[m_vColumns[x]];
+    }
+}
+
+// fn(band) for every band, on the workers and this thread
+void CFullscreenZoom::parallel(int bands, const std::function<void(int)>& fn) {
+    uint64_t serial = 0;
+
+    {
+        std::lock_guard lock(m_mtJob);
+        serial       = ++m_iJobSerial;
+        m_pJob       = &fn;
+        m_iBands     = bands;
+        m_iBandsLeft = bands;
+        m_iCursor    = serial << 32;
+    }
+    m_cvJob.notify_all();
+
+    runBands(serial, bands, &fn);
+
+    std::unique_lock lock(m_mtJob);
+    m_cvDone.wait(lock, [this]() { return m_iBandsLeft == 0; });
+}
+
+// takes bands of job serial until none are left. A worker that shows up after its job is done finds the serial moved
+// on and goes back to waiting, so it never runs a band of the next job with the function of the last one
+void CFullscreenZoom::runBands(uint64_t serial, int bands, const std::function<void(int)>* fn) {
+    uint64_t cursor = m_iCursor.load();
+
+    while (true) {
+        if (cursor >> 32 != (serial & 0xFFFFFFFF) || (int)(cursor & 0xFFFFFFFF) >= bands)
+            return;
+
+        if (!m_iCursor.compare_exchange_weak(cursor, cursor + 1))
+            continue;
+
+        (*fn)(cursor & 0xFFFFFFFF);
+        cursor = m_iCursor.load();
+
+        std::lock_guard lock(m_mtJob);
+        if (--m_iBandsLeft == 0)
+            m_cvDone.notify_one();
+    }
+}
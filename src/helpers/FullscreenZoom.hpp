@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../defines.hpp"
+#include "PoolBuffer.hpp"
+#include "CaptureImage.hpp"
+
+#include <atomic>
+#include <condition_variable>
+
+// Renders the whole pointer output magnified, straight from the tiles of the capture into the output buffer. Source
+// columns are looked up once per view, every output row is a gather from one source row (or a copy of the row above
+// when both show the same one), and the rows are split into bands that run on a few worker threads. What the last
+// frame already showed at the same scale is copied over shifted, only the rows and columns that came into view get
+// sampled.
+class CFullscreenZoom {
+  public:
+    CFullscreenZoom();
+    ~CFullscreenZoom();
+
+    // the view that keeps the pointer over the point of the image under it, kept inside the image. pointer is in
+    // image pixels, pointerBuffer in buffer pixels
+    static SZoomView viewFor(const Vector2D& pointer, const Vector2D& pointerBuffer, double scale, const Vector2D& imageSize, const Vector2D& bufferSize);
+
+    // draws view into buffer, which has to be in the depth of the image. previous is another buffer of the same size
+    // and depth that shows previous->drawn.zoom of the same image, nullptr if there is none. False if the image has
+    // nothing to show, the buffer is left as it was
+    bool             render(SPoolBuffer* buffer, CCaptureImage* image, const SPoolBuffer* previous, const SZoomView& view);
+
+  private:
+    void                               renderBand(uint32_t* pixels, const uint32_t* previous, int width, CCaptureImage* image, int y0, int y1, std::vector<uint32_t>& line);
+    void                               gather(uint32_t* row, CCaptureImage* image, int sy, int x0, int x1, std::vector<uint32_t>& line);
+    void                               parallel(int bands, const std::function<void(int)>& fn);
+    void                               runBands(uint64_t serial, int bands, const std::function<void(int)>* fn);
+
+    std::vector<int>                   m_vColumns; // source column of every buffer column
+    std::vector<int>                   m_vRows;    // and source row of every buffer row
+    std::vector<std::vector<uint32_t>> m_vLines;   // one source row per band
+
+    // the part of the buffer the previous frame still covers, and where it is in there
+    int                                m_iShiftX = 0, m_iShiftY = 0;
+    int                                m_iKeptX0 = 0, m_iKeptX1 = 0;
+    int                                m_iKeptY0 = 0, m_iKeptY1 = 0;
+
+    std::vector<std::thread>           m_vWorkers;
+    std::mutex                         m_mtJob;
+    std::condition_variable            m_cvJob;
+    std::condition_variable            m_cvDone;
+    const std::function<void(int)>*    m_pJob       = nullptr;
+    uint64_t                           m_iJobSerial = 0;
+    int                                m_iBands     = 0;
+    int                                m_iBandsLeft = 0;
+    bool                               m_bExit      = false;
+    std::atomic<uint64_t>              m_iCursor    = 0; // the job serial in the high half, the next band in the low one
+};
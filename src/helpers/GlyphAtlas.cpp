@@ -0,0 +1,123 @@
+#include "GlyphAtlas.hpp"
+
+#include <pango/pangocairo.h>
+
+// color at coverage out of 255 over a pixel, both premultiplied
+static uint32_t blendPixel(uint32_t px, const CColor& color, uint32_t coverage, bool highPrecision) {
+    const uint32_t A   = coverage * color.a / 255;
+    const uint32_t INV = 255 - A;
+
+    if (highPrecision) {
+        const uint32_t R = ((px >> 20) & 0x3FF) * INV / 255 + color.r * 1023 / 255 * A / 255;
+        const uint32_t G = ((px >> 10) & 0x3FF) * INV / 255 + color.g * 1023 / 255 * A / 255;
+        const uint32_t B = (px & 0x3FF) * INV / 255 + color.b * 1023 / 255 * A / 255;
+        return 0xC0000000 | R << 20 | G << 10 | B;
+    }
+
+    const uint32_t R = ((px >> 16) & 0xFF) * INV / 255 + color.r * A / 255;
+    const uint32_t G = ((px >> 8) & 0xFF) * INV / 255 + color.g * A / 255;
+    const uint32_t B = (px & 0xFF) * INV / 255 + color.b * A / 255;
+    const uint32_t O = (px >> 24) * INV / 255 + A;
+    return O << 24 | R << 16 | G << 8 | B;
+}
+
+CGlyphAtlas::CGlyphAtlas(int pixelHeight) : m_iPixelHeight(pixelHeight) {
+    const auto FONT = pango_font_description_from_string("monospace");
+    pango_font_description_set_absolute_size(FONT, pixelHeight * PANGO_SCALE);
+
+    // a monospace cell is as wide as any glyph's advance
+    const auto MEASURESURFACE = cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1);
+    const auto MEASURECAIRO   = cairo_create(MEASURESURFACE);
+    const auto MEASURELAYOUT  = pango_cairo_create_layout(MEASURECAIRO);
+    pango_layout_set_font_description(MEASURELAYOUT, FONT);
+    pango_layout_set_text(MEASURELAYOUT, "M", -1);
+
+    PangoRectangle logical;
+    pango_layout_get_pixel_extents(MEASURELAYOUT, nullptr, &logical);
+    m_iCellWidth  = std::max(logical.width, 1);
+    m_iCellHeight = std::max(logical.height, 1);
+
+    g_object_unref(MEASURELAYOUT);
+    cairo_destroy(MEASURECAIRO);
+    cairo_surface_destroy(MEASURESURFACE);
+
+    // every glyph in its own cell of one strip, laid out separately so nothing kerns into a neighbour
+    const int  COUNT   = LAST - FIRST + 1;
+    const auto SURFACE = cairo_image_surface_create(CAIRO_FORMAT_A8, m_iCellWidth * COUNT, m_iCellHeight);
+    const auto CAIRO   = cairo_create(SURFACE);
+    const auto LAYOUT  = pango_cairo_create_layout(CAIRO);
+    pango_layout_set_font_description(LAYOUT, FONT);
+    cairo_set_source_rgba(CAIRO, 0, 0, 0, 1);
+
+    for (int i = 0; i < COUNT; ++i) {
+        const char GLYPH = FIRST + i;
+        pango_layout_set_text(LAYOUT, &GLYPH, 1);
+        cairo_move_to(CAIRO, i * m_iCellWidth, 0);
+        pango_cairo_show_layout(CAIRO, LAYOUT);
+    }
+
+    cairo_surface_flush(SURFACE);
+
+    const auto DATA   = cairo_image_surface_get_data(SURFACE);
+    const int  STRIDE = cairo_image_surface_get_stride(SURFACE);
+
+    m_vCoverage.resize((size_t)COUNT * m_iCellWidth * m_iCellHeight);
+    for (int i = 0; i < COUNT; ++i) {
+        for (int y = 0; y < m_iCellHeight; ++y) {
+            memcpy(m_vCoverage.data() + ((size_t)i * m_iCellHeight + y) * m_iCellWidth, DATA + (size_t)y * STRIDE + i * m_iCellWidth, m_iCellWidth);
+        }
+    }
+
+    g_object_unref(LAYOUT);
+    cairo_destroy(CAIRO);
+    cairo_surface_destroy(SURFACE);
+    pango_font_description_free(FONT);
+}
+
+int CGlyphAtlas::pixelHeight() const {
+    return m_iPixelHeight;
+}
+
+int CGlyphAtlas::cellWidth() const {
+    return m_iCellWidth;
+}
+
+int CGlyphAtlas::cellHeight() const {
+    return m_iCellHeight;
+}
+
+void CGlyphAtlas::draw(uint32_t* dst, int width, int height, int x, int y, std::string_view text, const CColor& color, bool highPrecision) const {
+    const int Y0 = std::max(0, -y);
+    const int Y1 = std::min(m_iCellHeight, height - y);
+
+    for (size_t i = 0; i < text.size(); ++i) {
+        const int CX = x + (int)i * m_iCellWidth;
+
+        if (text[i] < FIRST || text[i] > LAST || text[i] == ' ')
+            continue;
+
+        const int      X0   = std::max(0, -CX);
+        const int      X1   = std::min(m_iCellWidth, width - CX);
+        const uint8_t* CELL = m_vCoverage.data() + (size_t)(text[i] - FIRST) * m_iCellWidth * m_iCellHeight;
+
+        for (int gy = Y0; gy < Y1; ++gy) {
+            const uint8_t* coverage = CELL + (size_t)gy * m_iCellWidth;
+            uint32_t*      row      = dst + (size_t)(y + gy) * width;
+
+            for (int gx = X0; gx < X1; ++gx) {
+                if (coverage[gx])
+                    row[CX + gx] = blendPixel(row[CX + gx], color, coverage[gx], highPrecision);
+            }
+        }
+    }
+}
+
+void CGlyphAtlas::shade(uint32_t* dst, int width, int height, int x, int y, int w, int h, const CColor& color, bool highPrecision) const {
+    for (int py = std::max(y, 0); py < std::min(y + h, height); ++py) {
+        uint32_t* row = dst + (size_t)py * width;
+
+        for (int px = std::max(x, 0); px < std::min(x + w, width); ++px) {
+            row[px] = blendPixel(row[px], color, 255, highPrecision);
+        }
+    }
+}
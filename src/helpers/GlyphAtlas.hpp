@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../defines.hpp"
+#include <string_view>
+
+// Printable ASCII of a monospace font, rasterised once with pango into coverage cells of one size. Drawing text is
+// then a blit per glyph with no layout pass.
+class CGlyphAtlas {
+  public:
+    CGlyphAtlas(int pixelHeight);
+
+    static constexpr char FIRST = ' ';
+    static constexpr char LAST  = '~';
+
+    int  pixelHeight() const;
+    int  cellWidth() const;
+    int  cellHeight() const;
+
+    // blends text in color over a packed ARGB32, or XRGB2101010 for highPrecision, buffer of width x height pixels.
+    // Characters outside of the atlas are skipped over, everything is clipped to the buffer
+    void draw(uint32_t* dst, int width, int height, int x, int y, std::string_view text, const CColor& color, bool highPrecision) const;
+    // blends color over a rect of the same kind of buffer, for the panel behind the text
+    void shade(uint32_t* dst, int width, int height, int x, int y, int w, int h, const CColor& color, bool highPrecision) const;
+
+  private:
+    int                  m_iPixelHeight = 0;
+    int                  m_iCellWidth   = 0;
+    int                  m_iCellHeight  = 0;
+
+    // one cellWidth x cellHeight block per character from FIRST on
+    std::vector<uint8_t> m_vCoverage;
+};
@@ -0,0 +1,72 @@
+#include "Governor.hpp"
+
+#include <format>
+
+// fractions of the refresh interval, with a wide gap so one step down doesn't look like headroom right away
+constexpr double PRESSURE_LOAD   = 0.75;
+constexpr double HEADROOM_LOAD   = 0.35;
+constexpr int    PRESSURE_FRAMES = 12;  // about 200ms at 60Hz, a single slow frame is no trend
+constexpr int    HEADROOM_FRAMES = 180; // about 3s at 60Hz, stepping back up costs a slow frame if it was wrong
+constexpr double SMOOTHING       = 0.1;
+
+void CQualityGovernor::addRender(uint64_t ns) {
+    m_iRenderNs += ns;
+}
+
+void CQualityGovernor::addIngest(uint64_t ns) {
+    m_iIngestNs += ns;
+}
+
+bool CQualityGovernor::onFrame(uint64_t refreshNs) {
+    m_dBudgetMs = refreshNs / 1000000.0;
+    m_dRenderMs += (m_iRenderNs / 1000000.0 - m_dRenderMs) * SMOOTHING;
+    m_dIngestMs += (m_iIngestNs / 1000000.0 - m_dIngestMs) * SMOOTHING;
+    m_iRenderNs = 0;
+    m_iIngestNs = 0;
+
+    if (!m_bEnabled || m_dBudgetMs <= 0.0)
+        return false;
+
+    const double LOAD = (m_dRenderMs + m_dIngestMs) / m_dBudgetMs;
+
+    m_iPressure = LOAD > PRESSURE_LOAD ? m_iPressure + 1 : 0;
+    m_iHeadroom = LOAD < HEADROOM_LOAD ? m_iHeadroom + 1 : 0;
+
+    const auto OLD = m_eLevel;
+
+    if (m_iPressure >= PRESSURE_FRAMES && m_eLevel + 1 < QUALITY_LEVELS)
+        m_eLevel = (eQualityLevel)(m_eLevel + 1);
+    else if (m_iHeadroom >= HEADROOM_FRAMES && m_eLevel > QUALITY_FULL)
+        m_eLevel = (eQualityLevel)(m_eLevel - 1);
+
+    if (m_eLevel == OLD)
+        return false;
+
+    // the averages still hold the old level's frames, both counts start over so the next step waits for new ones
+    m_iPressure = 0;
+    m_iHeadroom = 0;
+    m_iSteps++;
+
+    Debug::log(LOG, "Quality %s: render %.2fms, ingest %.2fms per frame of %.2fms", levelName(m_eLevel), m_dRenderMs, m_dIngestMs, m_dBudgetMs);
+
+    return true;
+}
+
+eQualityLevel CQualityGovernor::level() const {
+    return m_eLevel;
+}
+
+const char* CQualityGovernor::levelName(eQualityLevel level) {
+    switch (level) {
+        case QUALITY_FULL: return "full";
+        case QUALITY_FILTER: return "filter";
+        case QUALITY_CAPTURE: return "capture";
+        case QUALITY_BACKGROUND: return "background";
+        default: return "?";
+    }
+}
+
+std::string CQualityGovernor::report() const {
+    return std::format("quality {}{} (render {:.2f}ms ingest {:.2f}ms of {:.2f}ms, {} steps)", levelName(m_eLevel), m_bEnabled ? "" : " fixed", m_dRenderMs, m_dIngestMs,
+                       m_dBudgetMs, m_iSteps);
+}
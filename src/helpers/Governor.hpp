@@ -0,0 +1,44 @@
+#pragma once
+
+#include "../defines.hpp"
+
+// what the governor gave up, in the order it gives things up. Every level keeps the ones before it
+enum eQualityLevel {
+    QUALITY_FULL = 0,
+    QUALITY_FILTER,     // lens filters skip their sharpen pass
+    QUALITY_CAPTURE,    // --live recaptures at half the rate
+    QUALITY_BACKGROUND, // outputs other than the pointer's catch up in batches, see CQualityGovernor::BACKGROUND_INTERVAL_MS
+    QUALITY_LEVELS,
+};
+
+// Weighs the work behind each frame of the pointer output against that output's refresh interval: the main thread
+// rendering of every output since the previous frame, and the capture ingest on the workers. Sustained pressure steps
+// the quality down a level, sustained headroom steps it back up, with enough hysteresis in between not to flap.
+class CQualityGovernor {
+  public:
+    static constexpr uint64_t BACKGROUND_INTERVAL_MS = 100;
+
+    // ns of work, collected until the next frame of the pointer output
+    void               addRender(uint64_t ns);
+    void               addIngest(uint64_t ns);
+
+    // a frame of the pointer output went out, returns true if that changed the level
+    bool               onFrame(uint64_t refreshNs);
+
+    eQualityLevel      level() const;
+    static const char* levelName(eQualityLevel level);
+    std::string        report() const;
+
+    bool               m_bEnabled = true; // false only measures
+
+  private:
+    eQualityLevel m_eLevel    = QUALITY_FULL;
+    uint64_t      m_iRenderNs = 0; // since the previous frame
+    uint64_t      m_iIngestNs = 0;
+    double        m_dRenderMs = 0.0; // moving averages per frame
+    double        m_dIngestMs = 0.0;
+    double        m_dBudgetMs = 0.0;
+    int           m_iPressure = 0; // frames in a row over or under the thresholds
+    int           m_iHeadroom = 0;
+    uint64_t      m_iSteps    = 0;
+};
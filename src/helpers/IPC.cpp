@@ -0,0 +1,289 @@
+#include "IPC.hpp"
+#include "EventLoop.hpp"
+#include "../hyprmagnifier.hpp"
+
+#include <format>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+CIPCServer::CIPCServer(const std::string& path, CEventLoop* loop) : m_pLoop(loop), m_szPath(path) {
+    sockaddr_un addr = {.sun_family = AF_UNIX};
+
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        Debug::log(ERR, "IPC: invalid socket path \"%s\"", path.c_str());
+        return;
+    }
+
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    // someone answers on it, don't steal the socket
+    if (!request(path, "ping").empty()) {
+        Debug::log(WARN, "IPC: %s is owned by another instance, runtime control disabled", path.c_str());
+        return;
+    }
+
+    unlink(path.c_str());
+
+    m_iListenFD = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (m_iListenFD < 0) {
+        Debug::log(ERR, "IPC: failed to create a socket");
+        return;
+    }
+
+    if (bind(m_iListenFD, (sockaddr*)&addr, SUN_LEN(&addr)) < 0 || listen(m_iListenFD, 8) < 0) {
+        Debug::log(ERR, "IPC: failed to bind %s", path.c_str());
+        close(m_iListenFD);
+        m_iListenFD = -1;
+        return;
+    }
+
+    m_pLoop->addFd(m_iListenFD, [this]() { onAccept(); });
+
+    Debug::log(TRACE, "IPC: listening on %s", path.c_str());
+}
+
+CIPCServer::~CIPCServer() {
+    while (!m_mClients.empty()) {
+        closeClient(m_mClients.begin()->first);
+    }
+
+    if (m_iListenFD < 0)
+        return;
+
+    m_pLoop->removeFd(m_iListenFD);
+    close(m_iListenFD);
+    unlink(m_szPath.c_str());
+}
+
+bool CIPCServer::good() const {
+    return m_iListenFD >= 0;
+}
+
+void CIPCServer::closeClient(int fd) {
+    m_pLoop->removeFd(fd);
+    m_mClients.erase(fd);
+    close(fd);
+}
+
+void CIPCServer::onAccept() {
+    int client = -1;
+    while ((client = accept4(m_iListenFD, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0) {
+        m_mClients[client] = "";
+        m_pLoop->addFd(client, [this, client]() { onReadable(client); });
+    }
+}
+
+void CIPCServer::onReadable(int fd) {
+    auto it = m_mClients.find(fd);
+    if (it == m_mClients.end())
+        return;
+
+    char    buf[512];
+    ssize_t len = 0;
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        it->second.append(buf, len);
+    }
+
+    const auto NEWLINE = it->second.find('\n');
+
+    // wait for the rest of the line unless the client is done writing
+    if (NEWLINE == std::string::npos && len != 0 && it->second.size() < 4096)
+        return;
+
+    const auto REPLY = handleCommand(it->second.substr(0, NEWLINE)) + "\n";
+
+    if (write(fd, REPLY.c_str(), REPLY.size()) < 0)
+        Debug::log(TRACE, "IPC: failed to reply to a client");
+
+    closeClient(fd);
+}
+
+std::string CIPCServer::handleCommand(const std::string& command) {
+    std::istringstream iss(command);
+    std::string        cmd, arg;
+    iss >> cmd >> arg;
+
+    const auto PMAGNIFIER = g_pHyprmagnifier.get();
+
+    Debug::log(TRACE, "IPC: \"%s\"", command.c_str());
+
+    if (cmd == "ping")
+        return "pong";
+
+    if (cmd == "zoom") {
+        if (!arg.empty()) {
+            try {
+                PMAGNIFIER->m_dZoom = std::clamp(std::stod(arg), 0.01, CHyprmagnifier::MAX_ZOOM);
+            } catch (std::exception& e) { return "error: zoom must be a number"; }
+            PMAGNIFIER->markDirty();
+        }
+        return std::format("{:.3f}", PMAGNIFIER->m_dZoom);
+    }
+
+    if (cmd == "size") {
+        if (!arg.empty()) {
+            int width = 0, height = 0;
+            if (sscanf(arg.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+                return "error: size must be WIDTHxHEIGHT";
+            PMAGNIFIER->m_vSize = Vector2D{width, height};
+            PMAGNIFIER->markDirty();
+        }
+        return std::format("{:.0f}x{:.0f}", PMAGNIFIER->m_vSize.x, PMAGNIFIER->m_vSize.y);
+    }
+
+    if (cmd == "move") {
+        if (arg == "corner")
+            PMAGNIFIER->m_eMoveType = MOVE_CORNER;
+        else if (arg == "cursor") {
+            PMAGNIFIER->m_eMoveType = MOVE_CURSOR;
+            PMAGNIFIER->m_vPosition = PMAGNIFIER->m_vLastCoords;
+        } else if (!arg.empty())
+            return "error: move type must be corner or cursor";
+        PMAGNIFIER->markDirty();
+        return PMAGNIFIER->m_eMoveType == MOVE_CORNER ? "corner" : "cursor";
+    }
+
+    if (cmd == "inactive") {
+        if (arg == "1" || arg == "on")
+            PMAGNIFIER->m_bRenderInactive = true;
+        else if (arg == "0" || arg == "off")
+            PMAGNIFIER->m_bRenderInactive = false;
+        else if (!arg.empty())
+            return "error: inactive must be on or off";
+        PMAGNIFIER->markDirty();
+        return PMAGNIFIER->m_bRenderInactive ? "on" : "off";
+    }
+
+    if (cmd == "fullscreen") {
+        if (arg == "1" || arg == "on")
+            PMAGNIFIER->m_bFullscreen = true;
+        else if (arg == "0" || arg == "off")
+            PMAGNIFIER->m_bFullscreen = false;
+        else if (!arg.empty())
+            return "error: fullscreen must be on or off";
+        PMAGNIFIER->markDirty();
+        return PMAGNIFIER->m_bFullscreen ? "on" : "off";
+    }
+
+    if (cmd == "pin") {
+        if (!PMAGNIFIER->pinLens())
+            return "error: no lens to pin";
+        return std::format("{} pinned", PMAGNIFIER->m_vPinnedLenses.size());
+    }
+
+    if (cmd == "unpin") {
+        if (!arg.empty() && arg != "all")
+            return "error: unpin takes nothing or all";
+        PMAGNIFIER->unpinLens(arg == "all");
+        return std::format("{} pinned", PMAGNIFIER->m_vPinnedLenses.size());
+    }
+
+    if (cmd == "readout") {
+        if (arg == "1" || arg == "on")
+            PMAGNIFIER->m_bDisableHexPreview = false;
+        else if (arg == "0" || arg == "off")
+            PMAGNIFIER->m_bDisableHexPreview = true;
+        else if (!arg.empty())
+            return "error: readout must be on or off";
+        PMAGNIFIER->markDirty();
+        return PMAGNIFIER->m_bDisableHexPreview ? "off" : "on";
+    }
+
+    if (cmd == "filter") {
+        if (!arg.empty()) {
+            try {
+                PMAGNIFIER->setFilter(arg);
+            } catch (std::exception& e) { return std::string{"error: "} + e.what(); }
+        }
+        return PMAGNIFIER->m_pFilter ? PMAGNIFIER->m_pFilter->spec() : "none";
+    }
+
+    if (cmd == "snapshot") {
+        std::string path;
+        iss >> path;
+
+        if (!arg.empty() && arg != "lens" && arg != "full")
+            return "error: snapshot takes lens or full";
+        if (!path.empty() && !CSnapshotWriter::supportsPath(path))
+            return "error: snapshot path must end in .png, .jpg or .jpeg";
+
+        const auto WRITTEN = PMAGNIFIER->snapshot(arg == "full", path);
+        if (WRITTEN.empty())
+            return "error: nothing captured yet";
+        return WRITTEN;
+    }
+
+    if (cmd == "recapture") {
+        if (!PMAGNIFIER->recapture())
+            return "error: nothing to recapture";
+        return PMAGNIFIER->m_pLastSurface->m_pMonitor->name;
+    }
+
+    if (cmd == "get")
+        return std::format("zoom {:.3f}\nsize {:.0f}x{:.0f}\nmove {}\ninactive {}\nfullscreen {}\nactive {}\npinned {}\nfilter {}", PMAGNIFIER->m_dZoom,
+                           PMAGNIFIER->m_vSize.x, PMAGNIFIER->m_vSize.y, PMAGNIFIER->m_eMoveType == MOVE_CORNER ? "corner" : "cursor",
+                           PMAGNIFIER->m_bRenderInactive ? "on" : "off", PMAGNIFIER->m_bFullscreen ? "on" : "off", PMAGNIFIER->m_bActive ? "yes" : "no",
+                           PMAGNIFIER->m_vPinnedLenses.size(), PMAGNIFIER->m_pFilter ? PMAGNIFIER->m_pFilter->spec() : "none");
+
+    if (cmd == "stats")
+        return PMAGNIFIER->getStats();
+
+    if (cmd == "activate" || cmd == "deactivate" || cmd == "toggle") {
+        if (!PMAGNIFIER->m_bDaemon)
+            return "error: not running as a daemon";
+
+        if (cmd == "activate" || (cmd == "toggle" && !PMAGNIFIER->m_bActive))
+            PMAGNIFIER->activate();
+        else
+            PMAGNIFIER->deactivate();
+
+        return PMAGNIFIER->m_bActive ? "active" : "inactive";
+    }
+
+    if (cmd == "help")
+        return "commands: get, zoom [Z], size [WxH], move [corner|cursor], inactive [on|off], fullscreen [on|off], readout [on|off], pin, unpin [all], filter [SPEC|none], snapshot [lens|full] [PATH], recapture, stats, activate, deactivate, toggle";
+
+    return "error: unknown command \"" + cmd + "\"";
+}
+
+// client side, returns an empty string if nothing is listening
+std::string CIPCServer::request(const std::string& path, const std::string& command) {
+    sockaddr_un addr = {.sun_family = AF_UNIX};
+
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        return "";
+
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    const int FD = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (FD < 0)
+        return "";
+
+    if (connect(FD, (sockaddr*)&addr, SUN_LEN(&addr)) < 0) {
+        close(FD);
+        return "";
+    }
+
+    const auto LINE = command + "\n";
+    if (write(FD, LINE.c_str(), LINE.size()) < 0) {
+        close(FD);
+        return "";
+    }
+
+    shutdown(FD, SHUT_WR);
+
+    std::string reply;
+    char        buf[512];
+    ssize_t     len = 0;
+    while ((len = read(FD, buf, sizeof(buf))) > 0) {
+        reply.append(buf, len);
+    }
+
+    close(FD);
+
+    while (!reply.empty() && reply.back() == '\n')
+        reply.pop_back();
+
+    return reply;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "../defines.hpp"
+
+class CEventLoop;
+
+// Line based control socket under $XDG_RUNTIME_DIR. Every connection sends one
+// command terminated by a newline and receives one reply before it's closed.
+class CIPCServer {
+  public:
+    CIPCServer(const std::string& path, CEventLoop* loop);
+    ~CIPCServer();
+
+    bool               good() const;
+
+    static std::string request(const std::string& path, const std::string& command);
+
+  private:
+    void                                 onAccept();
+    void                                 onReadable(int fd);
+    std::string                          handleCommand(const std::string& command);
+    void                                 closeClient(int fd);
+
+    CEventLoop*                          m_pLoop     = nullptr;
+    int                                  m_iListenFD = -1;
+    std::string                          m_szPath;
+    std::unordered_map<int, std::string> m_mClients;
+};
@@ -0,0 +1,90 @@
+#include "Latency.hpp"
+
+void CLatencyTracker::setClock(clockid_t clock) {
+    m_iClock = clock;
+}
+
+uint64_t CLatencyTracker::now() const {
+    timespec ts;
+    clock_gettime(m_iClock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void CLatencyTracker::onPresented(uint64_t inputTime, uint64_t presentTime, uint32_t refreshNs) {
+    m_iRefreshNs = refreshNs;
+
+    if (presentTime < inputTime)
+        return;
+
+    const auto LATENCY = presentTime - inputTime;
+
+    m_iSamples++;
+    m_iSumNs += LATENCY;
+    m_iLastNs = LATENCY;
+    m_iMinNs  = std::min(m_iMinNs, LATENCY);
+    m_iMaxNs  = std::max(m_iMaxNs, LATENCY);
+
+    m_aHistogram[std::min<uint64_t>(LATENCY / 1000000ULL, HISTOGRAM_BUCKETS - 1)]++;
+
+    if (!m_bLive || presentTime - m_iLastReport < 1000000000ULL)
+        return;
+
+    m_iLastReport = presentTime;
+
+    Debug::log(LOG, "latency: last %.2fms, avg %.2fms, p95 %.0fms, max %.2fms (%lu frames, refresh %.2fms)", m_iLastNs / 1000000.0, averageMs(), percentile(0.95),
+               m_iMaxNs / 1000000.0, m_iSamples, m_iRefreshNs / 1000000.0);
+}
+
+void CLatencyTracker::onDiscarded() {
+    m_iDiscarded++;
+}
+
+double CLatencyTracker::averageMs() const {
+    return m_iSamples ? (double)m_iSumNs / m_iSamples / 1000000.0 : 0.0;
+}
+
+// upper bound of the bucket containing the p-th sample, in ms
+double CLatencyTracker::percentile(double p) const {
+    if (!m_iSamples)
+        return 0.0;
+
+    const uint64_t TARGET = std::max<uint64_t>(1, (uint64_t)std::ceil(p * m_iSamples));
+    uint64_t       seen   = 0;
+
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += m_aHistogram[i];
+        if (seen >= TARGET)
+            return i + 1;
+    }
+
+    return HISTOGRAM_BUCKETS;
+}
+
+void CLatencyTracker::printSummary() const {
+    if (!m_iSamples) {
+        Debug::log(LOG, "latency: no presented frames with input");
+        return;
+    }
+
+    Debug::log(LOG, "latency summary: %lu frames (%lu discarded), min %.2fms, avg %.2fms, p50 %.0fms, p95 %.0fms, p99 %.0fms, max %.2fms", m_iSamples, m_iDiscarded,
+               m_iMinNs / 1000000.0, averageMs(), percentile(0.5), percentile(0.95), percentile(0.99), m_iMaxNs / 1000000.0);
+}
+
+bool CLatencyTracker::dumpHistogram(const std::string& path) const {
+    std::ofstream ofs(path, std::ios::trunc);
+
+    if (!ofs.good()) {
+        Debug::log(ERR, "Failed to open %s for writing the latency histogram", path.c_str());
+        return false;
+    }
+
+    ofs << "# input-to-present latency, bucket upper bound (ms), frames\n";
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        if (i == HISTOGRAM_BUCKETS - 1)
+            ofs << ">" << i << " " << m_aHistogram[i] << "\n";
+        else
+            ofs << i + 1 << " " << m_aHistogram[i] << "\n";
+    }
+
+    return true;
+}
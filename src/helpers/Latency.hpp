@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../defines.hpp"
+#include <array>
+#include <ctime>
+
+// Tracks input-to-present latency using wp_presentation feedback.
+// Timestamps are nanoseconds on the presentation clock.
+class CLatencyTracker {
+  public:
+    static constexpr size_t HISTOGRAM_BUCKETS = 100; // 1ms each, last bucket is overflow
+
+    void                    setClock(clockid_t clock);
+    uint64_t                now() const;
+
+    void                    onPresented(uint64_t inputTime, uint64_t presentTime, uint32_t refreshNs);
+    void                    onDiscarded();
+
+    void                    printSummary() const;
+    bool                    dumpHistogram(const std::string& path) const;
+
+    double                  percentile(double p) const;
+    double                  averageMs() const;
+
+    uint64_t                m_iSamples   = 0;
+    uint64_t                m_iDiscarded = 0;
+    uint64_t                m_iMinNs     = UINT64_MAX;
+    uint64_t                m_iMaxNs     = 0;
+    uint64_t                m_iLastNs    = 0;
+    uint32_t                m_iRefreshNs = 0;
+
+    bool                    m_bLive = false; // log a live line at most once per second
+
+  private:
+    clockid_t                               m_iClock      = CLOCK_MONOTONIC;
+    uint64_t                                m_iSumNs      = 0;
+    uint64_t                                m_iLastReport = 0;
+    std::array<uint64_t, HISTOGRAM_BUCKETS> m_aHistogram  = {};
+};
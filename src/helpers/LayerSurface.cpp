@@ -2,7 +2,7 @@
 
 #include "../hyprmagnifier.hpp"
 
-CLayerSurface::CLayerSurface(SMonitor* pMonitor) : m_pMonitor(pMonitor) {
+CLayerSurface::CLayerSurface(SMonitor* pMonitor, bool mapNow) : m_pMonitor(pMonitor) {
     pSurface = makeShared<CCWlSurface>(g_pHyprmagnifier->m_pCompositor->sendCreateSurface());
 
     if (!pSurface) {
@@ -25,8 +25,17 @@ CLayerSurface::CLayerSurface(SMonitor* pMonitor) : m_pMonitor(pMonitor) {
         });
     }
 
+    if (mapNow)
+        map();
+}
+
+// gives the surface the layer role again, the compositor answers with a configure
+void CLayerSurface::map() {
+    if (pLayerSurface)
+        return;
+
     pLayerSurface = makeShared<CCZwlrLayerSurfaceV1>(
-        g_pHyprmagnifier->m_pLayerShell->sendGetLayerSurface(pSurface->resource(), pMonitor->output->resource(), ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY, "hyprmagnifier"));
+        g_pHyprmagnifier->m_pLayerShell->sendGetLayerSurface(pSurface->resource(), m_pMonitor->output->resource(), ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY, "hyprmagnifier"));
 
     if (!pLayerSurface) {
         Debug::log(CRIT, "The compositor did not allow hyprmagnifier a layersurface!");
@@ -35,6 +44,9 @@ CLayerSurface::CLayerSurface(SMonitor* pMonitor) : m_pMonitor(pMonitor) {
     }
 
     pLayerSurface->setConfigure([this](CCZwlrLayerSurfaceV1* r, uint32_t serial, uint32_t width, uint32_t height) {
+        if (!working)
+            g_pHyprmagnifier->traceStartup("configure", m_pMonitor);
+
         m_pMonitor->size = {(double)width, (double)height};
         ACKSerial        = serial;
         wantsACK         = true;
@@ -53,10 +65,34 @@ CLayerSurface::CLayerSurface(SMonitor* pMonitor) : m_pMonitor(pMonitor) {
     wl_display_flush(g_pHyprmagnifier->m_pWLDisplay);
 }
 
+// drops the layer role but keeps the wl_surface and every buffer around for the next map()
+void CLayerSurface::unmap() {
+    if (!pLayerSurface)
+        return;
+
+    frameCallback.reset();
+    feedbacks.clear();
+
+    pSurface->sendAttach(nullptr, 0, 0);
+    pSurface->sendCommit();
+    pLayerSurface.reset();
+
+    wantsACK    = false;
+    wantsReload = false;
+    working     = false;
+    captured    = false;
+    recapture   = RECAPTURE_NONE;
+    rendered    = false;
+    committed   = {};
+
+    wl_display_flush(g_pHyprmagnifier->m_pWLDisplay);
+}
+
 CLayerSurface::~CLayerSurface() {
     pLayerSurface.reset();
     pSurface.reset();
     frameCallback.reset();
+    feedbacks.clear();
 
     if (g_pHyprmagnifier->m_pWLDisplay)
         wl_display_flush(g_pHyprmagnifier->m_pWLDisplay);
@@ -69,14 +105,17 @@ static void onCallbackDone(CLayerSurface* surf, uint32_t when) {
     g_pHyprmagnifier->renderSurface(surf);
 }
 
-void CLayerSurface::sendFrame() {
-    lastBuffer          = lastBuffer == 0 ? 1 : 0;
-    const auto& PBUFFER = buffers[lastBuffer];
+static void onFeedbackDone(CLayerSurface* surf, CCWpPresentationFeedback* feedback) {
+    std::erase_if(surf->feedbacks, [feedback](const auto& other) { return other.get() == feedback; });
+}
 
+void CLayerSurface::sendFrame(SP<SPoolBuffer> PBUFFER, const std::vector<SDamageBox>& damage) {
     frameCallback = makeShared<CCWlCallback>(pSurface->sendFrame());
     frameCallback->setDone([this](CCWlCallback* r, uint32_t when) { onCallbackDone(this, when); });
 
-    pSurface->sendDamageBuffer(0, 0, 0xFFFF, 0xFFFF);
+    for (const auto& box : damage) {
+        pSurface->sendDamageBuffer(box.x, box.y, box.w, box.h);
+    }
 
     pSurface->sendAttach(PBUFFER->buffer.get(), 0, 0);
     if (!g_pHyprmagnifier->m_bNoFractional) {
@@ -85,6 +124,24 @@ void CLayerSurface::sendFrame() {
     } else
         pSurface->sendSetBufferScale(m_pMonitor->scale);
 
+    if (g_pHyprmagnifier->m_pPresentation) {
+        const auto PFEEDBACK  = feedbacks.emplace_back(makeShared<CCWpPresentationFeedback>(g_pHyprmagnifier->m_pPresentation->sendFeedback(pSurface->resource())));
+        const auto INPUTTIME  = inputTime;
+        inputTime             = 0;
+
+        PFEEDBACK->setPresented([this, INPUTTIME](CCWpPresentationFeedback* r, uint32_t tvSecHi, uint32_t tvSecLo, uint32_t tvNsec, uint32_t refresh, uint32_t seqHi, uint32_t seqLo,
+                                                  wpPresentationFeedbackKind flags) {
+            if (INPUTTIME)
+                g_pHyprmagnifier->m_pLatencyTracker->onPresented(INPUTTIME, (((uint64_t)tvSecHi << 32) | tvSecLo) * 1000000000ULL + tvNsec, refresh);
+            onFeedbackDone(this, r);
+        });
+        PFEEDBACK->setDiscarded([this, INPUTTIME](CCWpPresentationFeedback* r) {
+            if (INPUTTIME)
+                g_pHyprmagnifier->m_pLatencyTracker->onDiscarded();
+            onFeedbackDone(this, r);
+        });
+    }
+
     pSurface->sendCommit();
 }
 
@@ -2,40 +2,59 @@
 
 #include "../defines.hpp"
 #include "PoolBuffer.hpp"
+#include "CaptureImage.hpp"
 
 struct SMonitor;
 
+// a recapture on request takes the surface off the output first, so it doesn't end up in its own capture
+enum eRecaptureState {
+    RECAPTURE_NONE = 0,
+    RECAPTURE_HIDING,    // the next frame is empty
+    RECAPTURE_HIDDEN,    // the empty frame is up, its frame callback sends the capture
+    RECAPTURE_CAPTURING, // nothing is drawn until the new image is in
+};
+
 class CLayerSurface {
   public:
-    CLayerSurface(SMonitor*);
+    CLayerSurface(SMonitor*, bool mapNow = true);
     ~CLayerSurface();
 
-    void                      sendFrame();
-    void                      markDirty();
+    void                           map();
+    void                           unmap();
+    void                           sendFrame(SP<SPoolBuffer> buffer, const std::vector<SDamageBox>& damage);
+    void                           markDirty();
+
+    SMonitor*                      m_pMonitor = nullptr;
 
-    SMonitor*                 m_pMonitor = nullptr;
+    SP<CCZwlrLayerSurfaceV1>       pLayerSurface    = nullptr;
+    SP<CCWlSurface>                pSurface         = nullptr;
+    SP<CCWpViewport>               pViewport        = nullptr;
+    SP<CCWpFractionalScaleV1>      pFractionalScale = nullptr;
 
-    SP<CCZwlrLayerSurfaceV1>  pLayerSurface    = nullptr;
-    SP<CCWlSurface>           pSurface         = nullptr;
-    SP<CCWpViewport>          pViewport        = nullptr;
-    SP<CCWpFractionalScaleV1> pFractionalScale = nullptr;
+    float                          fractionalScale = 1.F;
+    bool                           wantsACK        = false;
+    bool                           wantsReload     = false;
+    uint32_t                       ACKSerial       = 0;
+    bool                           working         = false;
 
-    float                     fractionalScale = 1.F;
-    bool                      wantsACK        = false;
-    bool                      wantsReload     = false;
-    uint32_t                  ACKSerial       = 0;
-    bool                      working         = false;
+    SP<SPoolBuffer>                buffers[2];
+    SP<SPoolBuffer>                buffers10Bit[2]; // XRGB2101010, only for opaque frames of a high precision image
 
-    int                       lastBuffer = 0;
-    SP<SPoolBuffer>           buffers[2];
+    SP<SPoolBuffer>                captureBuffer;      // raw screencopy target, reused across captures
+    SP<SPoolBuffer>                spareCaptureBuffer; // the other one of the pair, see SMonitor::onBufferOffers
+    std::unique_ptr<CCaptureImage> image;
+    bool                           captured  = false;
+    uint32_t                       scflags   = 0;
+    eRecaptureState                recapture = RECAPTURE_NONE;
 
-    SP<SPoolBuffer>           screenBuffer;
-    uint32_t                  scflags            = 0;
-    uint32_t                  screenBufferFormat = 0;
+    bool                           dirty = true;
+    SDrawnFrame                    committed; // what the compositor shows, surface damage is relative to it
 
-    bool                      dirty = true;
+    bool                           rendered = false;
 
-    bool                      rendered = false;
+    SP<CCWlCallback>               frameCallback = nullptr;
 
-    SP<CCWlCallback>          frameCallback = nullptr;
+    // input timestamp the next commit was rendered from, see CHyprmagnifier::markInput
+    uint64_t                                  inputTime = 0;
+    std::vector<SP<CCWpPresentationFeedback>> feedbacks;
 };
\ No newline at end of file
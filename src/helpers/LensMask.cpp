@@ -0,0 +1,190 @@
+#include "LensMask.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// signed distance from the lens edge, negative inside. p is relative to the lens center
+static double rectDistance(const Vector2D& p, const Vector2D& half, double radius) {
+    const double QX = std::abs(p.x) - (half.x - radius);
+    const double QY = std::abs(p.y) - (half.y - radius);
+
+    return std::sqrt(std::pow(std::max(QX, 0.0), 2) + std::pow(std::max(QY, 0.0), 2)) + std::min(std::max(QX, QY), 0.0) - radius;
+}
+
+// not exact away from the edge, which is fine for a few pixels of anti-aliasing and border
+static double ellipseDistance(const Vector2D& p, const Vector2D& half) {
+    const double K0 = std::sqrt(std::pow(p.x / half.x, 2) + std::pow(p.y / half.y, 2));
+    const double K1 = std::sqrt(std::pow(p.x / (half.x * half.x), 2) + std::pow(p.y / (half.y * half.y), 2));
+
+    if (K1 == 0.0)
+        return -std::min(half.x, half.y);
+
+    return K0 * (K0 - 1.0) / K1;
+}
+
+static int paddingFor(double borderWidth) {
+    return std::ceil(std::max(borderWidth, 0.0) / 2.0) + 1;
+}
+
+CLensMask::CLensMask(const Vector2D& size, eLensShape shape, double radius, double borderWidth, const CColor& borderColor) : m_vSize(size), m_eShape(shape) {
+    borderWidth = std::max(borderWidth, 0.0);
+
+    m_iPad    = paddingFor(borderWidth);
+    m_iWidth  = std::round(size.x) + m_iPad * 2;
+    m_iHeight = std::round(size.y) + m_iPad * 2;
+
+    const size_t PIXELS = (size_t)m_iWidth * m_iHeight;
+    m_vRows.resize(m_iHeight);
+    m_vBackgroundWeight.resize(PIXELS);
+    m_vLensWeight.resize(PIXELS);
+    m_vBorder8Bit.resize(PIXELS);
+    m_vBorder10Bit.resize(PIXELS);
+
+    const Vector2D HALF   = size / 2.0;
+    const Vector2D CENTER = HALF + Vector2D{(double)m_iPad, (double)m_iPad};
+    const double   RADIUS = shape == LENS_ROUNDED ? std::clamp(radius, 0.0, std::min(HALF.x, HALF.y)) : 0.0;
+    const double   ALPHA  = borderColor.a / 255.0;
+
+    for (int y = 0; y < m_iHeight; ++y) {
+        auto& row = m_vRows[y];
+        row       = {.begin = m_iWidth, .end = 0, .solidBegin = m_iWidth, .solidEnd = 0};
+
+        for (int x = 0; x < m_iWidth; ++x) {
+            const Vector2D P = Vector2D{x + 0.5, y + 0.5} - CENTER;
+            const double   D = shape == LENS_CIRCLE ? ellipseDistance(P, HALF) : rectDistance(P, HALF, RADIUS);
+
+            // the border is centered on the edge like a cairo stroke
+            const double COVERAGE = std::clamp(0.5 - D, 0.0, 1.0);
+            const double BORDER   = borderWidth > 0.0 ? std::clamp(borderWidth / 2.0 + 0.5 - std::abs(D), 0.0, 1.0) * ALPHA : 0.0;
+
+            const size_t INDEX = (size_t)y * m_iWidth + x;
+
+            // the weights must not sum past 255, the blend has no headroom for that
+            m_vLensWeight[INDEX]       = std::round(COVERAGE * (1.0 - BORDER) * 255.0);
+            m_vBackgroundWeight[INDEX] = std::min<int>(std::round((1.0 - COVERAGE) * (1.0 - BORDER) * 255.0), 255 - m_vLensWeight[INDEX]);
+
+            const auto CHANNEL8  = [BORDER](uint8_t c) { return (uint32_t)std::round(c * BORDER); };
+            const auto CHANNEL10 = [BORDER](uint8_t c) { return (uint32_t)std::round(c / 255.0 * BORDER * 1023.0); };
+
+            m_vBorder8Bit[INDEX]  = ((uint32_t)std::round(BORDER * 255.0) << 24) | (CHANNEL8(borderColor.r) << 16) | (CHANNEL8(borderColor.g) << 8) | CHANNEL8(borderColor.b);
+            m_vBorder10Bit[INDEX] = (CHANNEL10(borderColor.r) << 20) | (CHANNEL10(borderColor.g) << 10) | CHANNEL10(borderColor.b);
+
+            if (m_vBackgroundWeight[INDEX] == 255)
+                continue;
+
+            row.begin = std::min(row.begin, x);
+            row.end   = x + 1;
+
+            if (m_vLensWeight[INDEX] == 255) {
+                row.solidBegin = std::min(row.solidBegin, x);
+                row.solidEnd   = x + 1;
+            }
+        }
+
+        if (row.begin >= row.end)
+            row = {};
+        else if (row.solidBegin >= row.solidEnd)
+            row.solidBegin = row.solidEnd = row.begin;
+    }
+}
+
+bool CLensMask::matches(const Vector2D& size, eLensShape shape) const {
+    return size == m_vSize && shape == m_eShape;
+}
+
+// lenses are placed like drawLens places them, the rounded top left corner minus the padding
+SDamageBox CLensMask::box(const SLensDraw& lens, double borderWidth) {
+    const int PAD = paddingFor(borderWidth);
+
+    return {
+        .x = (int)std::round(lens.center.x - (lens.size.x / 2.0)) - PAD,
+        .y = (int)std::round(lens.center.y - (lens.size.y / 2.0)) - PAD,
+        .w = (int)std::round(lens.size.x) + PAD * 2,
+        .h = (int)std::round(lens.size.y) + PAD * 2,
+    };
+}
+
+int CLensMask::width() const {
+    return m_iWidth;
+}
+
+int CLensMask::height() const {
+    return m_iHeight;
+}
+
+int CLensMask::padding() const {
+    return m_iPad;
+}
+
+const SLensRow& CLensMask::row(int y) const {
+    return m_vRows[y];
+}
+
+// (a * wa + b * wb) / 255 per 8 bit channel, plus a premultiplied border. Four pixels at a time with SSE2
+static void blendARGB32(uint32_t* dst, const uint32_t* lens, const uint8_t* bgWeight, const uint8_t* lensWeight, const uint32_t* border, int count) {
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128i ZERO = _mm_setzero_si128();
+    const __m128i HALF = _mm_set1_epi16(128);
+
+    // w0 w1 w2 w3 -> every weight repeated over its pixel's four channels
+    const auto expand = [](const uint8_t* w) {
+        int32_t packed = 0;
+        memcpy(&packed, w, sizeof(packed));
+        const __m128i V = _mm_cvtsi32_si128(packed);
+        return _mm_unpacklo_epi16(_mm_unpacklo_epi8(V, V), _mm_unpacklo_epi8(V, V));
+    };
+
+    const auto div255 = [HALF](__m128i x) {
+        x = _mm_add_epi16(x, HALF);
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    };
+
+    for (; i + 4 <= count; i += 4) {
+        const __m128i BG = _mm_loadu_si128((const __m128i*)(dst + i));
+        const __m128i LN = _mm_loadu_si128((const __m128i*)(lens + i));
+        const __m128i BD = _mm_loadu_si128((const __m128i*)(border + i));
+        const __m128i WB = expand(bgWeight + i);
+        const __m128i WL = expand(lensWeight + i);
+
+        const __m128i LO = div255(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(BG, ZERO), _mm_unpacklo_epi8(WB, ZERO)),
+                                                _mm_mullo_epi16(_mm_unpacklo_epi8(LN, ZERO), _mm_unpacklo_epi8(WL, ZERO))));
+        const __m128i HI = div255(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(BG, ZERO), _mm_unpackhi_epi8(WB, ZERO)),
+                                                _mm_mullo_epi16(_mm_unpackhi_epi8(LN, ZERO), _mm_unpackhi_epi8(WL, ZERO))));
+
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_adds_epu8(_mm_packus_epi16(LO, HI), BD));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        uint32_t out = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            const uint32_t V = (((dst[i] >> shift) & 0xFF) * bgWeight[i] + ((lens[i] >> shift) & 0xFF) * lensWeight[i] + 127) / 255 + ((border[i] >> shift) & 0xFF);
+            out |= std::min(V, 255u) << shift;
+        }
+        dst[i] = out;
+    }
+}
+
+// the 10 bit products don't fit 16 bit lanes, this one is left to the compiler
+static void blend2101010(uint32_t* dst, const uint32_t* lens, const uint8_t* bgWeight, const uint8_t* lensWeight, const uint32_t* border, int count) {
+    for (int i = 0; i < count; ++i) {
+        uint32_t out = 0xC0000000;
+        for (int shift = 0; shift < 30; shift += 10) {
+            const uint32_t V = (((dst[i] >> shift) & 0x3FF) * bgWeight[i] + ((lens[i] >> shift) & 0x3FF) * lensWeight[i] + 127) / 255 + ((border[i] >> shift) & 0x3FF);
+            out |= std::min(V, 1023u) << shift;
+        }
+        dst[i] = out;
+    }
+}
+
+void CLensMask::blend(uint32_t* dst, const uint32_t* lens, int x, int y, int count, bool highPrecision) const {
+    const size_t INDEX = (size_t)y * m_iWidth + x;
+
+    if (highPrecision)
+        blend2101010(dst, lens, &m_vBackgroundWeight[INDEX], &m_vLensWeight[INDEX], &m_vBorder10Bit[INDEX], count);
+    else
+        blendARGB32(dst, lens, &m_vBackgroundWeight[INDEX], &m_vLensWeight[INDEX], &m_vBorder8Bit[INDEX], count);
+}
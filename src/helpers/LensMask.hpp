@@ -0,0 +1,98 @@
+#pragma once
+
+#include "../defines.hpp"
+
+class CColorFilter;
+
+enum eLensShape {
+    LENS_RECT = 0,
+    LENS_ROUNDED,
+    LENS_CIRCLE // an ellipse for non-square lenses
+};
+
+// a lens as drawn into an output buffer, in buffer pixels. Equal draws from the same image produce the same pixels
+struct SLensDraw {
+    Vector2D                      center;
+    Vector2D                      size;
+    double                        zoom  = 0.5;
+    eLensShape                    shape = LENS_RECT;
+    std::shared_ptr<CColorFilter> filter;      // compared by identity, a new spec is a new filter
+    int                           readout = 0;     // glyph height of the color readout next to the lens, 0 for none
+    bool                          live    = false; // follows the pointer, possibly from another output
+    bool                          reduced = false; // filtered without sharpen, see CQualityGovernor
+    uint64_t                      sources = 0;     // generations of the captures of other outputs it samples, folded together
+    int                           cursor  = 0;     // size of the pointer sprite in buffer pixels, 0 for none
+    Vector2D                      hotspot;         // of the pointer in the buffer, where the lens shows it
+
+    bool                          operator==(const SLensDraw&) const = default;
+};
+
+// the part of the image a full-screen zoom shows: buffer pixel x shows image pixel floor((x + originX + 0.5) * scale),
+// and the same for y. The origin is in whole buffer pixels, so views at one scale are shifted copies of each other
+struct SZoomView {
+    int64_t originX = 0;
+    int64_t originY = 0;
+    double  scale   = 0.0; // image pixels per buffer pixel, 0 when the zoom is off
+
+    bool    operator==(const SZoomView&) const = default;
+};
+
+// what a frame showed, renderSurface repaints and damages only what differs between two of these
+struct SDrawnFrame {
+    uint64_t               generation = 0; // of the image, 0 for nothing
+    bool                   preview    = false;
+    Vector2D               size;
+    std::vector<SLensDraw> lenses;
+    SZoomView              zoom;
+};
+
+struct SDamageBox {
+    int  x = 0, y = 0, w = 0, h = 0;
+
+    bool intersects(const SDamageBox& other) const {
+        return x < other.x + other.w && other.x < x + w && y < other.y + other.h && other.y < y + h;
+    }
+};
+
+// the part of a mask row the lens touches, solid pixels are plain lens pixels that need no blending
+struct SLensRow {
+    int begin      = 0;
+    int end        = 0;
+    int solidBegin = 0;
+    int solidEnd   = 0;
+};
+
+// Anti-aliased coverage and border of a lens, built once per size and shape. The mask extends padding() pixels past the
+// lens on every side to fit the half of the border that lies outside of it.
+class CLensMask {
+  public:
+    CLensMask(const Vector2D& size, eLensShape shape, double radius, double borderWidth, const CColor& borderColor);
+
+    bool              matches(const Vector2D& size, eLensShape shape) const;
+
+    // pixels drawn for a lens, border included
+    static SDamageBox box(const SLensDraw& lens, double borderWidth);
+
+    int               width() const;
+    int               height() const;
+    int               padding() const;
+    const SLensRow&   row(int y) const;
+
+    // composites count lens pixels over dst for mask pixels x.. of row y. Both spans are packed ARGB32, or XRGB2101010 for highPrecision
+    void              blend(uint32_t* dst, const uint32_t* lens, int x, int y, int count, bool highPrecision) const;
+
+  private:
+    Vector2D              m_vSize;
+    eLensShape            m_eShape  = LENS_RECT;
+    int                   m_iWidth  = 0;
+    int                   m_iHeight = 0;
+    int                   m_iPad    = 0;
+
+    std::vector<SLensRow> m_vRows;
+    // per pixel weights of the background and the lens out of 255, whatever is left goes to the border
+    std::vector<uint8_t> m_vBackgroundWeight;
+    std::vector<uint8_t> m_vLensWeight;
+    // premultiplied border sprites in both output formats
+    std::vector<uint32_t> m_vBorder8Bit;
+    std::vector<uint32_t> m_vBorder10Bit;
+};
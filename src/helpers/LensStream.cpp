@@ -0,0 +1,300 @@
+#include "LensStream.hpp"
+#include "Formats.hpp"
+
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <format>
+#include <climits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// BT.601 full range ("C420jpeg" in Y4M terms) in Q14
+constexpr int Y_R = 4899, Y_G = 9617, Y_B = 1868;
+constexpr int U_R = -2765, U_G = -5427, U_B = 8192;
+constexpr int V_R = 8192, V_G = -6860, V_B = -1332;
+
+static uint8_t clampByte(int v) {
+    return std::clamp(v, 0, 255);
+}
+
+// luma of count ARGB32 pixels
+static void lumaRow(const uint32_t* src, uint8_t* dst, int count) {
+    int x = 0;
+
+#if defined(__SSE2__)
+    const __m128i ZERO   = _mm_setzero_si128();
+    const __m128i COEFFS = _mm_setr_epi16(Y_B, Y_G, Y_R, 0, Y_B, Y_G, Y_R, 0);
+    const __m128i ROUND  = _mm_set1_epi32(1 << 13);
+
+    for (; x + 4 <= count; x += 4) {
+        const __m128i PX = _mm_loadu_si128((const __m128i*)(src + x));
+
+        // b * Y_B + g * Y_G and r * Y_R per pixel, then the halves added up in lanes 0 and 2
+        const __m128i LO  = _mm_madd_epi16(_mm_unpacklo_epi8(PX, ZERO), COEFFS);
+        const __m128i HI  = _mm_madd_epi16(_mm_unpackhi_epi8(PX, ZERO), COEFFS);
+        const __m128i SLO = _mm_shuffle_epi32(_mm_add_epi32(LO, _mm_shuffle_epi32(LO, _MM_SHUFFLE(2, 3, 0, 1))), _MM_SHUFFLE(3, 1, 2, 0));
+        const __m128i SHI = _mm_shuffle_epi32(_mm_add_epi32(HI, _mm_shuffle_epi32(HI, _MM_SHUFFLE(2, 3, 0, 1))), _MM_SHUFFLE(3, 1, 2, 0));
+
+        __m128i       y = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi64(SLO, SHI), ROUND), 14);
+        y               = _mm_packus_epi16(_mm_packs_epi32(y, y), ZERO);
+
+        const int32_t OUT = _mm_cvtsi128_si32(y);
+        memcpy(dst + x, &OUT, 4);
+    }
+#endif
+
+    for (; x < count; ++x) {
+        const int R = (src[x] >> 16) & 0xFF, G = (src[x] >> 8) & 0xFF, B = src[x] & 0xFF;
+        dst[x]      = clampByte((Y_R * R + Y_G * G + Y_B * B + (1 << 13)) >> 14);
+    }
+}
+
+// chroma of the 2x2 blocks of two ARGB32 rows
+static void chromaRow(const uint32_t* top, const uint32_t* bottom, uint8_t* u, uint8_t* v, int count) {
+    for (int x = 0; x < count; ++x) {
+        int r = 0, g = 0, b = 0;
+        for (const uint32_t PX : {top[x * 2], top[x * 2 + 1], bottom[x * 2], bottom[x * 2 + 1]}) {
+            r += (PX >> 16) & 0xFF;
+            g += (PX >> 8) & 0xFF;
+            b += PX & 0xFF;
+        }
+
+        // sums of four, so two more bits of shift
+        u[x] = clampByte(((U_R * r + U_G * g + U_B * b + (1 << 15)) >> 16) + 128);
+        v[x] = clampByte(((V_R * r + V_G * g + V_B * b + (1 << 15)) >> 16) + 128);
+    }
+}
+
+CLensStream::CLensStream(const std::string& path, eStreamFormat format, uint32_t rate) : m_eFormat(format), m_iRate(std::max(rate, 1u)), m_szPath(path) {
+    // a fifo blocks here until its reader shows up, every write after that doesn't
+    if (path == "-") {
+        // the stream takes over stdout, logs go on on stderr
+        std::cout.flush();
+        m_iFD = openStdout();
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    } else {
+        m_iFD = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (m_iFD >= 0)
+            fcntl(m_iFD, F_SETFL, fcntl(m_iFD, F_GETFL) | O_NONBLOCK);
+    }
+
+    if (m_iFD < 0)
+        throw std::runtime_error(std::format("can't open {}: {}", path, strerror(errno)));
+
+    // a reader that goes away shows up as EPIPE from the write instead
+    signal(SIGPIPE, SIG_IGN);
+}
+
+CLensStream::~CLensStream() {
+    if (m_iFD >= 0)
+        ::close(m_iFD);
+}
+
+// O_NONBLOCK lives in the open file description, which a dup of stdout shares with the shell and every other writer of
+// the same pipe or terminal. Pipes and terminals are opened again for a description of our own, sockets stay blocking
+// and get MSG_DONTWAIT per send, files never block anyway
+int CLensStream::openStdout() {
+    struct stat st;
+    if (fstat(STDOUT_FILENO, &st) != 0)
+        return -1;
+
+    if (S_ISSOCK(st.st_mode)) {
+        m_bSocket = true;
+        return fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    }
+
+    if (!S_ISFIFO(st.st_mode) && !S_ISCHR(st.st_mode))
+        return fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+
+    return ::open("/proc/self/fd/1", O_WRONLY | O_CLOEXEC | O_NONBLOCK);
+}
+
+// writev that never blocks, EAGAIN when the reader has no room
+ssize_t CLensStream::writeOut(const iovec* iov, size_t count) {
+    if (!m_bSocket)
+        return writev(m_iFD, iov, count);
+
+    msghdr msg = {.msg_iov = (iovec*)iov, .msg_iovlen = count};
+    return sendmsg(m_iFD, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+eStreamFormat CLensStream::formatFor(const std::string& path) {
+    return path.ends_with(".y4m") ? STREAM_Y4M : STREAM_RAW;
+}
+
+bool CLensStream::open() const {
+    return m_iFD >= 0;
+}
+
+uint64_t CLensStream::framesWritten() const {
+    return m_iFramesWritten;
+}
+
+uint64_t CLensStream::framesDropped() const {
+    return m_iFramesDropped;
+}
+
+void CLensStream::close(const char* reason) {
+    Debug::log(LOG, "Stopped streaming to %s after %lu frames (%lu dropped): %s", m_szPath.c_str(), m_iFramesWritten, m_iFramesDropped, reason);
+
+    ::close(m_iFD);
+    m_iFD = -1;
+}
+
+void CLensStream::writeFrame(const SPoolBuffer* buffer, const Vector2D& center, const Vector2D& size) {
+    if (m_iFD < 0)
+        return;
+
+    if (!m_iWidth) {
+        m_iWidth  = std::min(size.x, buffer->pixelSize.x);
+        m_iHeight = std::min(size.y, buffer->pixelSize.y);
+
+        // I420 needs whole 2x2 blocks
+        if (m_eFormat == STREAM_Y4M) {
+            m_iWidth &= ~1;
+            m_iHeight &= ~1;
+            m_szHeader = std::format("YUV4MPEG2 W{} H{} F{}:1 Ip A1:1 C420jpeg\n", m_iWidth, m_iHeight, m_iRate);
+        }
+
+        Debug::log(LOG, "Streaming %dx%d lens frames to %s", m_iWidth, m_iHeight, m_szPath.c_str());
+    }
+
+    if (m_iWidth <= 0 || m_iHeight <= 0 || m_iWidth > buffer->pixelSize.x || m_iHeight > buffer->pixelSize.y)
+        return;
+
+    const int       X0     = std::clamp((int)std::round(center.x - m_iWidth / 2.0), 0, (int)buffer->pixelSize.x - m_iWidth);
+    const int       Y0     = std::clamp((int)std::round(center.y - m_iHeight / 2.0), 0, (int)buffer->pixelSize.y - m_iHeight);
+    const uint32_t* pixels = (const uint32_t*)buffer->data;
+    size_t          stride = buffer->pixelSize.x;
+
+    // 2101010 frames are narrowed once, 8-bit ones are read where they are
+    if (buffer->format == WL_SHM_FORMAT_XRGB2101010) {
+        const auto NARROW = Formats::info(WL_SHM_FORMAT_XRGB2101010)->to8Bit;
+
+        m_vRows.resize((size_t)m_iWidth * m_iHeight);
+        for (int y = 0; y < m_iHeight; ++y) {
+            NARROW((const uint8_t*)(pixels + (size_t)(Y0 + y) * stride + X0), 4, m_vRows.data() + (size_t)y * m_iWidth, m_iWidth);
+        }
+
+        pixels = m_vRows.data();
+        stride = m_iWidth;
+    } else
+        pixels += (size_t)Y0 * stride + X0;
+
+    m_vIovecs.clear();
+    if (!m_szHeader.empty())
+        m_vIovecs.push_back({.iov_base = m_szHeader.data(), .iov_len = m_szHeader.size()});
+
+    if (m_eFormat == STREAM_RAW) {
+        // one iovec per row straight out of the buffer, writev copies them into the pipe before this returns
+        for (int y = 0; y < m_iHeight; ++y) {
+            m_vIovecs.push_back({.iov_base = (void*)(pixels + (size_t)y * stride), .iov_len = (size_t)m_iWidth * 4});
+        }
+    } else {
+        toI420(pixels, stride);
+        m_vIovecs.push_back({.iov_base = m_vPlanes.data(), .iov_len = m_vPlanes.size()});
+    }
+
+    submit(m_vIovecs);
+
+    if (m_iFramesWritten)
+        m_szHeader.clear();
+}
+
+// "FRAME\n", then the Y, U and V planes
+void CLensStream::toI420(const uint32_t* pixels, size_t stride) {
+    static constexpr std::string_view FRAME = "FRAME\n";
+
+    const size_t                      LUMA   = (size_t)m_iWidth * m_iHeight;
+    const size_t                      CHROMA = LUMA / 4;
+
+    m_vPlanes.resize(FRAME.size() + LUMA + CHROMA * 2);
+    memcpy(m_vPlanes.data(), FRAME.data(), FRAME.size());
+
+    uint8_t* y = m_vPlanes.data() + FRAME.size();
+    uint8_t* u = y + LUMA;
+    uint8_t* v = u + CHROMA;
+
+    for (int row = 0; row < m_iHeight; ++row) {
+        lumaRow(pixels + row * stride, y + (size_t)row * m_iWidth, m_iWidth);
+    }
+
+    for (int row = 0; row < m_iHeight / 2; ++row) {
+        chromaRow(pixels + row * 2 * stride, pixels + (row * 2 + 1) * stride, u + (size_t)row * m_iWidth / 2, v + (size_t)row * m_iWidth / 2, m_iWidth / 2);
+    }
+}
+
+// finishes a frame the pipe only took part of, true once nothing is left
+bool CLensStream::flushPending() {
+    while (m_iPendingOffset < m_vPending.size()) {
+        const iovec   IOV = {.iov_base = m_vPending.data() + m_iPendingOffset, .iov_len = m_vPending.size() - m_iPendingOffset};
+        const ssize_t RET = writeOut(&IOV, 1);
+
+        if (RET < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN)
+                close(strerror(errno));
+            return false;
+        }
+
+        m_iPendingOffset += RET;
+    }
+
+    m_vPending.clear();
+    m_iPendingOffset = 0;
+    return true;
+}
+
+// writes a whole frame or none of it, whatever the pipe doesn't take right away is kept for flushPending
+void CLensStream::submit(std::span<iovec> iov) {
+    if (!flushPending()) {
+        if (m_iFD >= 0)
+            m_iFramesDropped++;
+        return;
+    }
+
+    size_t first   = 0;
+    bool   started = false;
+
+    while (first < iov.size()) {
+        const ssize_t RET = writeOut(iov.data() + first, std::min<size_t>(iov.size() - first, IOV_MAX));
+
+        if (RET < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN) {
+                close(strerror(errno));
+                return;
+            }
+            if (!started) {
+                m_iFramesDropped++;
+                return;
+            }
+            break;
+        }
+
+        started = true;
+
+        // skip what went out, the iovec written halfway starts where the write stopped
+        size_t left = RET;
+        while (first < iov.size() && left >= iov[first].iov_len) {
+            left -= iov[first].iov_len;
+            first++;
+        }
+
+        if (first < iov.size()) {
+            iov[first].iov_base = (uint8_t*)iov[first].iov_base + left;
+            iov[first].iov_len -= left;
+        }
+    }
+
+    // the buffer is redrawn before the reader comes back, so the rest of the frame is copied out
+    for (; first < iov.size(); ++first) {
+        m_vPending.insert(m_vPending.end(), (uint8_t*)iov[first].iov_base, (uint8_t*)iov[first].iov_base + iov[first].iov_len);
+    }
+
+    m_iFramesWritten++;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../defines.hpp"
+#include "PoolBuffer.hpp"
+#include <span>
+#include <sys/uio.h>
+
+enum eStreamFormat {
+    STREAM_RAW = 0, // packed BGRA, width x height x 4 bytes per frame
+    STREAM_Y4M      // YUV4MPEG2 with I420 frames
+};
+
+// Writes the pixels around the live lens of every rendered frame to a file or a pipe. The frame size is fixed by the
+// first frame, a rect of that size centered on the lens and kept inside the output is what gets written.
+// Writes never block: a frame the reader has no room for is dropped whole, and a frame the pipe only took part of
+// is finished before the next one goes out.
+class CLensStream {
+  public:
+    // "-" for stdout. Throws std::runtime_error if path can't be opened
+    CLensStream(const std::string& path, eStreamFormat format, uint32_t rate);
+    ~CLensStream();
+
+    // y4m for a .y4m path, raw otherwise
+    static eStreamFormat formatFor(const std::string& path);
+
+    // center and size in buffer pixels
+    void                 writeFrame(const SPoolBuffer* buffer, const Vector2D& center, const Vector2D& size);
+
+    bool                 open() const;
+    uint64_t             framesWritten() const;
+    uint64_t             framesDropped() const;
+
+  private:
+    int                   openStdout();
+    ssize_t               writeOut(const iovec* iov, size_t count);
+    void                  submit(std::span<iovec> iov);
+    bool                  flushPending();
+    void                  close(const char* reason);
+    void                  toI420(const uint32_t* pixels, size_t stride);
+
+    int                   m_iFD     = -1;
+    bool                  m_bSocket = false; // stdout was a socket, see openStdout
+    eStreamFormat         m_eFormat = STREAM_RAW;
+    uint32_t              m_iRate   = 60;
+    int                   m_iWidth  = 0;
+    int                   m_iHeight = 0;
+    std::string           m_szPath;
+    std::string           m_szHeader; // until the first frame goes out
+
+    std::vector<uint8_t>  m_vPending; // the rest of a frame the reader didn't take in one go
+    size_t                m_iPendingOffset = 0;
+
+    std::vector<uint32_t> m_vRows;   // 8-bit copies of 2101010 rows
+    std::vector<uint8_t>  m_vPlanes; // "FRAME\n" and the I420 planes
+    std::vector<iovec>    m_vIovecs;
+
+    uint64_t              m_iFramesWritten = 0;
+    uint64_t              m_iFramesDropped = 0;
+};
@@ -0,0 +1,59 @@
+#include "MemoryTracker.hpp"
+
+#include <format>
+
+static const char* categoryName(int category) {
+    switch (category) {
+        case MEM_CAPTURE: return "capture";
+        case MEM_OUTPUT: return "output";
+        case MEM_TILES: return "tiles";
+        case MEM_PREVIEW: return "preview";
+        default: return "?";
+    }
+}
+
+static std::string formatBytes(size_t bytes) {
+    return std::format("{:.1f}MiB", bytes / 1048576.0);
+}
+
+void CMemoryTracker::onAlloc(eMemoryCategory category, const std::string& owner, size_t bytes) {
+    std::lock_guard<std::mutex> lg(m_mtLock);
+
+    for (auto* usage : {&m_mUsage[{category, owner}], &m_sTotal}) {
+        usage->current += bytes;
+        usage->peak = std::max(usage->peak, usage->current);
+        usage->allocs++;
+    }
+}
+
+void CMemoryTracker::onFree(eMemoryCategory category, const std::string& owner, size_t bytes) {
+    std::lock_guard<std::mutex> lg(m_mtLock);
+
+    for (auto* usage : {&m_mUsage[{category, owner}], &m_sTotal}) {
+        usage->current -= std::min(usage->current, bytes);
+    }
+}
+
+size_t CMemoryTracker::current() {
+    std::lock_guard<std::mutex> lg(m_mtLock);
+    return m_sTotal.current;
+}
+
+size_t CMemoryTracker::peak() {
+    std::lock_guard<std::mutex> lg(m_mtLock);
+    return m_sTotal.peak;
+}
+
+std::string CMemoryTracker::report() {
+    std::lock_guard<std::mutex> lg(m_mtLock);
+
+    std::string result = std::format("memory: current {}, peak {}, {} allocations\n", formatBytes(m_sTotal.current), formatBytes(m_sTotal.peak), m_sTotal.allocs);
+    result += std::format("  {:<8} {:<12} {:>10} {:>10} {:>7}", "category", "output", "current", "peak", "allocs");
+
+    for (const auto& [key, usage] : m_mUsage) {
+        result += std::format("\n  {:<8} {:<12} {:>10} {:>10} {:>7}", categoryName(key.first), key.second.empty() ? "?" : key.second, formatBytes(usage.current),
+                              formatBytes(usage.peak), usage.allocs);
+    }
+
+    return result;
+}
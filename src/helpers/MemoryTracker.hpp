@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../defines.hpp"
+#include <mutex>
+#include <map>
+
+enum eMemoryCategory {
+    MEM_CAPTURE = 0, // shm screencopy targets
+    MEM_OUTPUT,      // shm buffers committed to the layer surfaces
+    MEM_TILES,       // committed pages of the full resolution capture tiles
+    MEM_PREVIEW,     // heap, decimated background
+    MEM_CATEGORIES,
+};
+
+// Byte accounting of the big allocations, per category and output. Thread safe, conversion workers allocate too.
+class CMemoryTracker {
+  public:
+    void        onAlloc(eMemoryCategory category, const std::string& owner, size_t bytes);
+    void        onFree(eMemoryCategory category, const std::string& owner, size_t bytes);
+
+    std::string report();
+    size_t      current();
+    size_t      peak();
+
+  private:
+    struct SUsage {
+        size_t   current = 0;
+        size_t   peak    = 0;
+        uint64_t allocs  = 0;
+    };
+
+    std::mutex                                    m_mtLock;
+    std::map<std::pair<int, std::string>, SUsage> m_mUsage;
+    SUsage                                        m_sTotal;
+};
@@ -1,15 +1,23 @@
 #include "Monitor.hpp"
 #include "LayerSurface.hpp"
 #include "../hyprmagnifier.hpp"
+#include "Formats.hpp"
 
 SMonitor::SMonitor(SP<CCWlOutput> output_) : output(output_) {
     output->setGeometry([this](CCWlOutput* r, int32_t x, int32_t y, int32_t width_mm, int32_t height_mm, int32_t subpixel, const char* make, const char* model,
                                int32_t transform_) { //
         transform = (wl_output_transform)transform_;
+        // only a fallback, xdg_output has the logical position where compositors disagree on this one
+        if (!xdgOutput)
+            position = {(double)x, (double)y};
     });
     output->setDone([this](CCWlOutput* r) { //
         ready = true;
     });
+    output->setMode([this](CCWlOutput* r, uint32_t flags, int32_t width, int32_t height, int32_t refresh_) { //
+        if (flags & WL_OUTPUT_MODE_CURRENT)
+            refresh = refresh_;
+    });
     output->setScale([this](CCWlOutput* r, int32_t scale_) { //
         scale = scale_;
     });
@@ -19,103 +27,224 @@ SMonitor::SMonitor(SP<CCWlOutput> output_) : output(output_) {
     });
 }
 
-void SMonitor::initSCFrame() {
-    pSCFrame->setBuffer([this](CCZwlrScreencopyFrameV1* r, uint32_t format, uint32_t width, uint32_t height, uint32_t stride) {
-        pLS->screenBufferFormat = format;
+SMonitor::~SMonitor() {
+    joinWorker();
+}
+
+void SMonitor::initXDGOutput() {
+    if (xdgOutput || !g_pHyprmagnifier->m_pXDGOutputMgr)
+        return;
+
+    xdgOutput = makeShared<CCZxdgOutputV1>(g_pHyprmagnifier->m_pXDGOutputMgr->sendGetXdgOutput(output->resource()));
+    xdgOutput->setLogicalPosition([this](CCZxdgOutputV1* r, int32_t x, int32_t y) { //
+        position = {(double)x, (double)y};
+    });
+}
+
+void SMonitor::joinWorker() {
+    if (worker.joinable())
+        worker.join();
+}
+
+void SMonitor::capture(bool warmup) {
+    // the previous conversion may still read the capture buffer this copy would land in
+    joinWorker();
+
+    captureSerial++;
+    shmOffer    = {};
+    dmabufOffer = {};
+
+    pSCFrame = makeShared<CCZwlrScreencopyFrameV1>(g_pHyprmagnifier->m_pScreencopyMgr->sendCaptureOutput(false, output->resource()));
+
+    initSCFrame(warmup);
+}
 
-        if (!pLS->screenBuffer)
-            pLS->screenBuffer = makeShared<SPoolBuffer>(Vector2D{(double)width, (double)height}, format, stride);
+void SMonitor::initSCFrame(bool warmup) {
+    pSCFrame->setBuffer([this, warmup](CCZwlrScreencopyFrameV1* r, uint32_t format, uint32_t width, uint32_t height, uint32_t stride) {
+        shmOffer = {.offered = true, .format = format, .stride = stride, .size = {(double)width, (double)height}};
 
-        pSCFrame->sendCopy(pLS->screenBuffer->buffer->resource());
+        // before v3 there is nothing else to wait for
+        if (g_pHyprmagnifier->m_iScreencopyVersion < 3)
+            onBufferOffers(warmup);
     });
+    pSCFrame->setLinuxDmabuf([this](CCZwlrScreencopyFrameV1* r, uint32_t format, uint32_t width, uint32_t height) {
+        dmabufOffer = {.offered = true, .format = format, .size = {(double)width, (double)height}};
+    });
+    pSCFrame->setBufferDone([this, warmup](CCZwlrScreencopyFrameV1* r) { onBufferOffers(warmup); });
     pSCFrame->setFlags([this](CCZwlrScreencopyFrameV1* r, uint32_t flags) {
         pLS->scflags = flags;
-
-        g_pHyprmagnifier->recheckACK();
     });
     pSCFrame->setReady([this](CCZwlrScreencopyFrameV1* r, uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec) {
-        Vector2D transformedSize = pLS->screenBuffer->pixelSize;
-
-        if (pLS->m_pMonitor->transform % 2 == 1)
-            std::swap(transformedSize.x, transformedSize.y);
-
-        Debug::log(TRACE, "Frame ready: pixel %.0fx%.0f, xfmd: %.0fx%.0f", pLS->screenBuffer->pixelSize.x, pLS->screenBuffer->pixelSize.y, transformedSize.x, transformedSize.y);
-
-        SP<SPoolBuffer> newBuf = makeShared<SPoolBuffer>(transformedSize, pLS->screenBufferFormat, transformedSize.x * 4);
-
-        int             bytesPerPixel = pLS->screenBuffer->stride / (int)pLS->screenBuffer->pixelSize.x;
-        void*           data          = pLS->screenBuffer->data;
-        if (bytesPerPixel == 4)
-            g_pHyprmagnifier->convertBuffer(pLS->screenBuffer);
-        else if (bytesPerPixel == 3) {
-            Debug::log(WARN, "24 bit formats are unsupported, hyprmagnifier may or may not work as intended!");
-            data                          = g_pHyprmagnifier->convert24To32Buffer(pLS->screenBuffer);
-            pLS->screenBuffer->paddedData = data;
-        } else {
-            Debug::log(CRIT, "Unsupported stride/bytes per pixel %i", bytesPerPixel);
-            g_pHyprmagnifier->finish(1);
-        }
+        const auto SERIAL = captureSerial;
 
-        cairo_surface_t* oldSurface = cairo_image_surface_create_for_data((unsigned char*)data, CAIRO_FORMAT_ARGB32, pLS->screenBuffer->pixelSize.x, pLS->screenBuffer->pixelSize.y,
-                                                                          pLS->screenBuffer->pixelSize.x * 4);
+        pLS->captureBuffer->beginRead();
 
-        cairo_surface_flush(oldSurface);
+        // recaptures are shown right away, render reads the image so they stay on this thread and the image switches
+        // buffers between two frames
+        if (pLS->captured) {
+            processCapture();
+            onCaptureProcessed(SERIAL);
+            return;
+        }
 
-        newBuf->surface = cairo_image_surface_create_for_data((unsigned char*)newBuf->data, CAIRO_FORMAT_ARGB32, transformedSize.x, transformedSize.y, transformedSize.x * 4);
+        joinWorker();
+        worker = std::thread([this, SERIAL]() {
+            processCapture();
+            g_pHyprmagnifier->m_pEventLoop->doLater([this, SERIAL]() { onCaptureProcessed(SERIAL); });
+        });
+    });
+    pSCFrame->setFailed([this, warmup](CCZwlrScreencopyFrameV1* r) {
+        // a compositor can import the dmabuf and still fail to copy into it, shm gets a go before giving up
+        if (pLS->captureBuffer && pLS->captureBuffer->dmabufFD >= 0 && g_pHyprmagnifier->m_pUdmabuf) {
+            g_pHyprmagnifier->disableDmabuf("screencopy into a udmabuf failed");
+
+            const auto SERIAL = captureSerial;
+            g_pHyprmagnifier->m_pEventLoop->doLater([this, warmup, SERIAL]() {
+                if (SERIAL == captureSerial)
+                    capture(warmup);
+            });
+            return;
+        }
 
-        const auto PCAIRO = cairo_create(newBuf->surface);
+        Debug::log(CRIT, "Failed to get a Screencopy!");
+        g_pHyprmagnifier->finish(1);
+    });
+}
 
-        auto       cairoTransformMtx = [&](cairo_matrix_t* mtx) -> void {
-            const auto TR = pLS->m_pMonitor->transform % 4;
+// picks what the frame is copied into: a udmabuf if the compositor offered a dmabuf format the image can read, shm otherwise
+void SMonitor::onBufferOffers(bool warmup) {
+    const bool DMABUF = dmabufOffer.offered && g_pHyprmagnifier->m_pUdmabuf && CCaptureImage::supportsFormat(Formats::fromDRM(dmabufOffer.format));
+    const auto OFFER  = DMABUF ? dmabufOffer : shmOffer;
+    const auto FORMAT = DMABUF ? Formats::fromDRM(OFFER.format) : OFFER.format;
 
-            if (TR == 0)
+    if (!OFFER.offered || !CCaptureImage::supportsFormat(FORMAT)) {
+        Debug::log(CRIT, "Unsupported format %i", FORMAT);
+        g_pHyprmagnifier->finish(1);
+    }
+
+    // the image converts tiles out of the buffer of its capture until the next one is processed, so a copy never lands
+    // in the buffer the image reads but in the other one of the pair
+    if (pLS->image && pLS->captureBuffer && pLS->image->raw() == pLS->captureBuffer)
+        std::swap(pLS->captureBuffer, pLS->spareCaptureBuffer);
+
+    const auto& BUFFER = pLS->captureBuffer;
+    // a snapshot still encoding from the last capture keeps it, the copy goes to a fresh buffer instead
+    const bool REUSE = BUFFER && BUFFER->buffer && BUFFER->pixelSize == OFFER.size && BUFFER->format == FORMAT && (BUFFER->dmabufFD >= 0) == DMABUF &&
+        (DMABUF || BUFFER->stride == OFFER.stride) && !g_pHyprmagnifier->m_pSnapshots->reads(BUFFER.get());
+
+    if (!REUSE && DMABUF) {
+        pLS->captureBuffer = makeShared<SPoolBuffer>(OFFER.size, OFFER.format, name);
+
+        if (!pLS->captureBuffer->data) {
+            pLS->captureBuffer.reset();
+            g_pHyprmagnifier->disableDmabuf("can't allocate a udmabuf");
+            onBufferOffers(warmup);
+            return;
+        }
+
+        // the import is a roundtrip, the copy goes out once the compositor took the buffer
+        const auto SERIAL  = captureSerial;
+        const auto PBUFFER = pLS->captureBuffer.get();
+        pLS->captureBuffer->importDmabuf([this, warmup, SERIAL, PBUFFER](bool imported) {
+            // unmapped or recaptured in the meantime
+            if (SERIAL != captureSerial || !pSCFrame || pLS->captureBuffer.get() != PBUFFER)
                 return;
 
-            cairo_matrix_rotate(mtx, -M_PI_2 * (double)TR);
+            if (!imported) {
+                pLS->captureBuffer.reset();
+                g_pHyprmagnifier->disableDmabuf("the compositor refused a udmabuf");
+            }
 
-            if (TR == 1)
-                cairo_matrix_translate(mtx, -transformedSize.x, 0);
-            else if (TR == 2)
-                cairo_matrix_translate(mtx, -transformedSize.x, -transformedSize.y);
-            else if (TR == 3)
-                cairo_matrix_translate(mtx, 0, -transformedSize.y);
+            onBufferOffers(warmup);
+        });
+        return;
+    }
 
-            // TODO: flipped
-        };
+    if (!REUSE)
+        pLS->captureBuffer = makeShared<SPoolBuffer>(OFFER.size, FORMAT, OFFER.stride, MEM_CAPTURE, name);
 
-        cairo_save(PCAIRO);
+    if (warmup) {
+        preallocate();
+        pSCFrame.reset();
+        return;
+    }
 
-        cairo_set_source_rgba(PCAIRO, 0, 0, 0, 0);
+    // the compositor writes into it from here on
+    pLS->captureBuffer->endRead();
+    pSCFrame->sendCopy(pLS->captureBuffer->buffer->resource());
+}
 
-        cairo_rectangle(PCAIRO, 0, 0, 0xFFFF, 0xFFFF);
-        cairo_fill(PCAIRO);
+// points the image at the new capture and builds its preview, the lens converts full resolution tiles on demand
+void SMonitor::processCapture() {
+    const auto BEGIN           = std::chrono::steady_clock::now();
+    const auto RAW             = pLS->captureBuffer;
+    Vector2D   transformedSize = RAW->pixelSize;
 
-        const auto PATTERNPRE = cairo_pattern_create_for_surface(oldSurface);
-        cairo_pattern_set_filter(PATTERNPRE, CAIRO_FILTER_BILINEAR);
-        cairo_matrix_t matrixPre;
-        cairo_matrix_init_identity(&matrixPre);
-        cairo_matrix_scale(&matrixPre, 1.0, 1.0);
-        cairoTransformMtx(&matrixPre);
-        cairo_pattern_set_matrix(PATTERNPRE, &matrixPre);
-        cairo_set_source(PCAIRO, PATTERNPRE);
-        cairo_paint(PCAIRO);
+    if (transform % 2 == 1)
+        std::swap(transformedSize.x, transformedSize.y);
 
-        cairo_surface_flush(newBuf->surface);
+    Debug::log(TRACE, "Frame ready: pixel %.0fx%.0f, xfmd: %.0fx%.0f", RAW->pixelSize.x, RAW->pixelSize.y, transformedSize.x, transformedSize.y);
 
-        cairo_pattern_destroy(PATTERNPRE);
+    ensureImage(transformedSize);
 
-        cairo_destroy(PCAIRO);
+    pLS->image->setSource(RAW, transform);
 
-        cairo_surface_destroy(oldSurface);
+    ingestNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - BEGIN).count();
+}
 
-        pLS->screenBuffer = newBuf;
+void SMonitor::onCaptureProcessed(uint64_t serial) {
+    joinWorker();
 
-        g_pHyprmagnifier->renderSurface(pLS);
+    g_pHyprmagnifier->m_pGovernor->addIngest(ingestNs);
 
-        pSCFrame.reset();
-    });
-    pSCFrame->setFailed([](CCZwlrScreencopyFrameV1* r) {
-        Debug::log(CRIT, "Failed to get a Screencopy!");
-        g_pHyprmagnifier->finish(1);
-    });
+    // unmapped or recaptured in the meantime
+    if (serial != captureSerial || !pSCFrame)
+        return;
+
+    // a recapture only changes what this surface shows, the others keep their frames and their frame callbacks
+    if (pLS->captured) {
+        pLS->recapture = RECAPTURE_NONE;
+        if (!pLS->frameCallback)
+            pLS->markDirty();
+    } else {
+        g_pHyprmagnifier->traceStartup("capture ready", this);
+
+        pLS->captured = true;
+
+        g_pHyprmagnifier->recheckACK();
+    }
+
+    pSCFrame.reset();
+}
+
+// 10-bit captures keep their precision if the compositor takes 2101010 shm buffers back
+void SMonitor::ensureImage(const Vector2D& size) {
+    const bool HIGHPRECISION = g_pHyprmagnifier->use10Bit() && CCaptureImage::isHighPrecisionFormat(pLS->captureBuffer->format);
+
+    if (!pLS->image || pLS->image->size() != size || pLS->image->highPrecision() != HIGHPRECISION)
+        pLS->image = std::make_unique<CCaptureImage>(size, name, HIGHPRECISION);
+}
+
+// allocates the transformed image and the output buffers ahead of the first capture, sized after the raw capture
+void SMonitor::preallocate() {
+    Vector2D transformedSize = pLS->captureBuffer->pixelSize;
+
+    if (transform % 2 == 1)
+        std::swap(transformedSize.x, transformedSize.y);
+
+    ensureImage(transformedSize);
+
+    for (auto& b : pLS->buffers) {
+        if (!b || b->pixelSize != transformedSize)
+            b = makeShared<SPoolBuffer>(transformedSize, WL_SHM_FORMAT_ARGB8888, transformedSize.x * 4, MEM_OUTPUT, name);
+    }
+
+    if (pLS->image->highPrecision()) {
+        for (auto& b : pLS->buffers10Bit) {
+            if (!b || b->pixelSize != transformedSize)
+                b = makeShared<SPoolBuffer>(transformedSize, WL_SHM_FORMAT_XRGB2101010, transformedSize.x * 4, MEM_OUTPUT, name);
+        }
+    }
+
+    Debug::log(TRACE, "Preallocated buffers for %s: %.0fx%.0f", name.c_str(), transformedSize.x, transformedSize.y);
 }
\ No newline at end of file
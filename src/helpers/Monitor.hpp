@@ -6,19 +6,46 @@ using namespace Hyprutils::Math;
 
 class CLayerSurface;
 
+// a buffer type screencopy offered for the frame in flight
+struct SBufferOffer {
+    bool     offered = false;
+    uint32_t format  = 0; // wl_shm, or a DRM fourcc for a dmabuf
+    uint32_t stride  = 0; // shm only
+    Vector2D size;
+};
+
 struct SMonitor {
     SMonitor(SP<CCWlOutput> output_);
-    void                        initSCFrame();
+    ~SMonitor();
+    void                        capture(bool warmup = false);
+    void                        initSCFrame(bool warmup = false);
+    void                        onBufferOffers(bool warmup);
+    void                        preallocate();
+    void                        ensureImage(const Vector2D& size);
+    void                        processCapture();
+    void                        onCaptureProcessed(uint64_t serial);
+    void                        joinWorker();
+    void                        initXDGOutput();
 
     std::string                 name         = "";
     SP<CCWlOutput>              output       = nullptr;
+    SP<CCZxdgOutputV1>          xdgOutput    = nullptr;
     uint32_t                    wayland_name = 0;
     Vector2D                    size;
+    Vector2D                    position; // logical, in the global layout of outputs
     int                         scale;
     wl_output_transform         transform = WL_OUTPUT_TRANSFORM_NORMAL;
+    int32_t                     refresh   = 0; // mHz of the current mode, 0 if unknown
 
     bool                        ready = false;
 
     CLayerSurface*              pLS      = nullptr;
     SP<CCZwlrScreencopyFrameV1> pSCFrame = nullptr;
+    SBufferOffer                shmOffer;
+    SBufferOffer                dmabufOffer; // from screencopy v3 on
+
+    // converts the first capture after a map, so multiple outputs are processed in parallel
+    std::thread worker;
+    uint64_t    captureSerial = 0;
+    uint64_t    ingestNs      = 0; // of the last processCapture, read once the worker is joined
 };
\ No newline at end of file
@@ -1,7 +1,12 @@
 #include "PoolBuffer.hpp"
 #include "../hyprmagnifier.hpp"
+#include "Formats.hpp"
 
-SPoolBuffer::SPoolBuffer(const Vector2D& pixelSize_, uint32_t format_, uint32_t stride_) : stride(stride_), pixelSize(pixelSize_), format(format_) {
+#include <sys/ioctl.h>
+#include <linux/dma-buf.h>
+
+SPoolBuffer::SPoolBuffer(const Vector2D& pixelSize_, uint32_t format_, uint32_t stride_, eMemoryCategory category_, const std::string& owner_) :
+    stride(stride_), pixelSize(pixelSize_), format(format_), category(category_), owner(owner_) {
     const size_t SIZE = stride * pixelSize.y;
 
     const auto   FD = g_pHyprmagnifier->createPoolFile(SIZE, name);
@@ -16,6 +21,8 @@ SPoolBuffer::SPoolBuffer(const Vector2D& pixelSize_, uint32_t format_, uint32_t
     size = SIZE;
     data = DATA;
 
+    g_pHyprmagnifier->m_pMemoryTracker->onAlloc(category, owner, size);
+
     auto POOL = makeShared<CCWlShmPool>(g_pHyprmagnifier->m_pSHM->sendCreatePool(FD, SIZE));
     buffer    = makeShared<CCWlBuffer>(POOL->sendCreateBuffer(0, pixelSize.x, pixelSize.y, stride, format));
 
@@ -26,17 +33,77 @@ SPoolBuffer::SPoolBuffer(const Vector2D& pixelSize_, uint32_t format_, uint32_t
     close(FD);
 }
 
+SPoolBuffer::SPoolBuffer(const Vector2D& pixelSize_, uint32_t drmFormat_, const std::string& owner_) :
+    pixelSize(pixelSize_), format(Formats::fromDRM(drmFormat_)), drmFormat(drmFormat_), category(MEM_CAPTURE), owner(owner_) {
+    // GPU importers want aligned rows, 256 bytes covers the ones around
+    stride = ((uint32_t)pixelSize.x * Formats::info(format)->bytes + 255) & ~255u;
+
+    if (!g_pHyprmagnifier->m_pUdmabuf->allocate((size_t)stride * pixelSize.y, dmabufFD, data, size)) {
+        data = nullptr;
+        size = 0;
+        return;
+    }
+
+    g_pHyprmagnifier->m_pMemoryTracker->onAlloc(category, owner, size);
+}
+
+void SPoolBuffer::importDmabuf(std::function<void(bool)> onDone) {
+    dmabufParams = makeShared<CCZwpLinuxBufferParamsV1>(g_pHyprmagnifier->m_pLinuxDmabuf->sendCreateParams());
+
+    // onDone may well drop this buffer, so it runs once the event is dispatched
+    dmabufParams->setCreated([this, onDone](CCZwpLinuxBufferParamsV1* r, wl_proxy* wlBuffer) {
+        buffer = makeShared<CCWlBuffer>(wlBuffer);
+        buffer->setRelease([this](CCWlBuffer* r) { busy = false; });
+        g_pHyprmagnifier->m_pEventLoop->doLater([onDone]() { onDone(true); });
+    });
+    dmabufParams->setFailed([onDone](CCZwpLinuxBufferParamsV1* r) { g_pHyprmagnifier->m_pEventLoop->doLater([onDone]() { onDone(false); }); });
+
+    // one linear plane, the modifier goes as its high and low halves
+    dmabufParams->sendAdd(dmabufFD, 0, 0, stride, 0, 0);
+    dmabufParams->sendCreate(pixelSize.x, pixelSize.y, drmFormat, 0);
+}
+
+static void syncDmabuf(int fd, uint64_t flags) {
+    dma_buf_sync sync = {.flags = flags};
+
+    while (ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync) < 0 && (errno == EINTR || errno == EAGAIN)) {
+        ;
+    }
+}
+
+void SPoolBuffer::beginRead() {
+    if (dmabufFD < 0 || reading)
+        return;
+
+    syncDmabuf(dmabufFD, DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ);
+    reading = true;
+}
+
+void SPoolBuffer::endRead() {
+    if (dmabufFD < 0 || !reading)
+        return;
+
+    syncDmabuf(dmabufFD, DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ);
+    reading = false;
+}
+
 SPoolBuffer::~SPoolBuffer() {
+    dmabufParams.reset();
     buffer.reset();
     cairo_destroy(cairo);
     cairo_surface_destroy(surface);
-    munmap(data, size);
+    endRead();
+
+    if (data)
+        munmap(data, size);
+
+    g_pHyprmagnifier->m_pMemoryTracker->onFree(category, owner, size);
 
     cairo   = nullptr;
     surface = nullptr;
 
-    unlink(name.c_str());
-
-    if (paddedData)
-        free(paddedData);
+    if (dmabufFD >= 0)
+        close(dmabufFD);
+    else
+        unlink(name.c_str());
 }
@@ -1,26 +1,43 @@
 #pragma once
 
 #include "../defines.hpp"
+#include "MemoryTracker.hpp"
+#include "LensMask.hpp"
 
 struct SPoolBuffer {
-    SPoolBuffer(const Vector2D& size, uint32_t format, uint32_t stride);
+    SPoolBuffer(const Vector2D& size, uint32_t format, uint32_t stride, eMemoryCategory category, const std::string& owner);
+    // a screencopy target out of a udmabuf, format is the wl_shm one of drmFormat. data is nullptr if the allocation
+    // failed, buffer stays nullptr until importDmabuf went through
+    SPoolBuffer(const Vector2D& size, uint32_t drmFormat, const std::string& owner);
     ~SPoolBuffer();
 
+    // hands the dmabuf to the compositor, onDone(false) if it was refused
+    void             importDmabuf(std::function<void(bool)> onDone);
+    // bracket CPU reads of what the compositor wrote into a dmabuf, no-ops for shm
+    void             beginRead();
+    void             endRead();
+
     SP<CCWlBuffer>   buffer  = nullptr;
     cairo_surface_t* surface = nullptr;
     cairo_t*         cairo   = nullptr;
     void*            data    = nullptr;
 
-    // malloc'ed buffer for 24bit formats
-    void*       paddedData = nullptr;
+    size_t           size   = 0;
+    uint32_t         stride = 0;
+    Vector2D         pixelSize;
+
+    uint32_t         format;
 
-    size_t      size   = 0;
-    uint32_t    stride = 0;
-    Vector2D    pixelSize;
+    int                          dmabufFD  = -1;
+    uint32_t                     drmFormat = 0;
+    SP<CCZwpLinuxBufferParamsV1> dmabufParams;
+    bool                         reading = false;
 
-    uint32_t    format;
+    std::string      name;
 
-    std::string name;
+    bool             busy = false;
+    SDrawnFrame      drawn; // contents of an output buffer as of its last render
 
-    bool        busy = false;
+    eMemoryCategory  category;
+    std::string      owner;
 };
\ No newline at end of file
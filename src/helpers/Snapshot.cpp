@@ -0,0 +1,191 @@
+#include "Snapshot.hpp"
+#include "../hyprmagnifier.hpp"
+
+#include <csetjmp>
+#include <format>
+#include <ctime>
+#include <jpeglib.h>
+
+constexpr int JPEG_QUALITY = 92;
+
+static std::string extensionOf(const std::string& path) {
+    auto extension = std::filesystem::path(path).extension().string();
+    std::ranges::transform(extension, extension.begin(), ::tolower);
+    return extension;
+}
+
+static bool isJPEG(const std::string& path) {
+    const auto EXTENSION = extensionOf(path);
+    return EXTENSION == ".jpg" || EXTENSION == ".jpeg";
+}
+
+// libjpeg reports errors by calling error_exit, which must not return
+struct SJPEGError {
+    jpeg_error_mgr mgr;
+    jmp_buf        jump;
+    char           message[JMSG_LENGTH_MAX] = {};
+};
+
+static void onJPEGError(j_common_ptr info) {
+    const auto ERROR = (SJPEGError*)info->err;
+    info->err->format_message(info, ERROR->message);
+    longjmp(ERROR->jump, 1);
+}
+
+// streams converted rows into the encoder, one row of scratch no matter the size of the image
+static std::string writeJPEG(const SRawView& view, const std::string& path) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return strerror(errno);
+
+    jpeg_compress_struct  cinfo;
+    SJPEGError            error;
+    std::vector<uint32_t> row(view.width);
+#if !defined(JCS_EXTENSIONS)
+    std::vector<uint8_t> rgb((size_t)view.width * 3);
+#endif
+
+    cinfo.err            = jpeg_std_error(&error.mgr);
+    error.mgr.error_exit = onJPEGError;
+
+    if (setjmp(error.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        fclose(file);
+        unlink(path.c_str());
+        return error.message;
+    }
+
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, file);
+
+    cinfo.image_width  = view.width;
+    cinfo.image_height = view.height;
+#if defined(JCS_EXTENSIONS)
+    // libjpeg-turbo reads ARGB32 rows as they are
+    cinfo.input_components = 4;
+    cinfo.in_color_space   = JCS_EXT_BGRX;
+#else
+    cinfo.input_components = 3;
+    cinfo.in_color_space   = JCS_RGB;
+#endif
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, JPEG_QUALITY, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    for (int y = 0; y < view.height; ++y) {
+        view.to8Bit(view.origin + y * view.stepY, view.stepX, row.data(), view.width);
+
+#if defined(JCS_EXTENSIONS)
+        JSAMPROW sample = (JSAMPROW)row.data();
+#else
+        for (int x = 0; x < view.width; ++x) {
+            rgb[x * 3]     = row[x] >> 16;
+            rgb[x * 3 + 1] = row[x] >> 8;
+            rgb[x * 3 + 2] = row[x];
+        }
+        JSAMPROW sample = rgb.data();
+#endif
+
+        jpeg_write_scanlines(&cinfo, &sample, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    if (fclose(file) != 0)
+        return strerror(errno);
+
+    return "";
+}
+
+// 32-bit captures in their natural orientation go to cairo as they are, anything else is converted once
+static std::string writePNG(const SRawView& view, const std::string& path) {
+    const bool            NATIVE = (view.format == WL_SHM_FORMAT_XRGB8888 || view.format == WL_SHM_FORMAT_ARGB8888) && view.stepX == 4 && view.stepY > 0;
+    std::vector<uint32_t> converted;
+    cairo_surface_t*      surface = nullptr;
+
+    if (NATIVE)
+        surface = cairo_image_surface_create_for_data((unsigned char*)view.origin, CAIRO_FORMAT_RGB24, view.width, view.height, view.stepY);
+    else {
+        converted.resize((size_t)view.width * view.height);
+        for (int y = 0; y < view.height; ++y) {
+            view.to8Bit(view.origin + y * view.stepY, view.stepX, converted.data() + (size_t)y * view.width, view.width);
+        }
+        surface = cairo_image_surface_create_for_data((unsigned char*)converted.data(), CAIRO_FORMAT_RGB24, view.width, view.height, view.width * 4);
+    }
+
+    const auto STATUS = cairo_surface_write_to_png(surface, path.c_str());
+    cairo_surface_destroy(surface);
+
+    return STATUS == CAIRO_STATUS_SUCCESS ? "" : cairo_status_to_string(STATUS);
+}
+
+CSnapshotWriter::~CSnapshotWriter() {
+    for (auto& job : m_vJobs) {
+        if (job->thread.joinable())
+            job->thread.join();
+    }
+}
+
+bool CSnapshotWriter::supportsPath(const std::string& path) {
+    return isJPEG(path) || extensionOf(path) == ".png";
+}
+
+std::string CSnapshotWriter::defaultPath(const std::string& what, const std::string& extension) {
+    std::string directory = ".";
+
+    if (const auto XDGPICTURESDIR = getenv("XDG_PICTURES_DIR"); XDGPICTURESDIR && std::filesystem::is_directory(XDGPICTURESDIR))
+        directory = XDGPICTURESDIR;
+    else if (const auto HOME = getenv("HOME"); HOME && std::filesystem::is_directory(std::string(HOME) + "/Pictures"))
+        directory = std::string(HOME) + "/Pictures";
+
+    const auto NOW    = std::chrono::system_clock::now();
+    const auto TIME   = std::chrono::system_clock::to_time_t(NOW);
+    const auto MILLIS = std::chrono::duration_cast<std::chrono::milliseconds>(NOW.time_since_epoch()).count() % 1000;
+
+    char       stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&TIME));
+
+    return std::format("{}/hyprmagnifier-{}-{:03}-{}.{}", directory, stamp, MILLIS, what, extension);
+}
+
+void CSnapshotWriter::save(const SRawView& view, SP<SPoolBuffer> keepAlive, std::vector<uint32_t>&& pixels, const std::string& path) {
+    auto&      job = m_vJobs.emplace_back(std::make_unique<SJob>());
+
+    const auto ID  = m_iNextID++;
+    job->id        = ID;
+    job->keepAlive = keepAlive;
+    job->pixels    = std::move(pixels);
+
+    // the worker only ever sees plain pointers, the shared ones are released back on the main thread in onDone
+    job->thread = std::thread([this, view, path, ID]() {
+        const auto BEGIN = std::chrono::steady_clock::now();
+        const auto ERROR = isJPEG(path) ? writeJPEG(view, path) : writePNG(view, path);
+        const auto MS    = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - BEGIN).count();
+
+        g_pHyprmagnifier->m_pEventLoop->doLater([this, ID, path, ERROR, MS]() { onDone(ID, path, ERROR, MS); });
+    });
+}
+
+void CSnapshotWriter::onDone(uint64_t id, const std::string& path, const std::string& error, double ms) {
+    const auto IT = std::ranges::find_if(m_vJobs, [id](const auto& job) { return job->id == id; });
+    if (IT == m_vJobs.end())
+        return;
+
+    (*IT)->thread.join();
+    m_vJobs.erase(IT);
+
+    if (error.empty())
+        Debug::log(LOG, "Saved a snapshot to %s in %.1fms", path.c_str(), ms);
+    else
+        Debug::log(ERR, "Failed to save a snapshot to %s: %s", path.c_str(), error.c_str());
+}
+
+bool CSnapshotWriter::reads(const SPoolBuffer* buffer) const {
+    return std::ranges::any_of(m_vJobs, [buffer](const auto& job) { return job->keepAlive.get() == buffer; });
+}
+
+size_t CSnapshotWriter::pending() const {
+    return m_vJobs.size();
+}
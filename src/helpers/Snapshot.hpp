@@ -0,0 +1,36 @@
+#pragma once
+
+#include "../defines.hpp"
+#include "CaptureImage.hpp"
+
+// Writes PNG or JPEG snapshots on worker threads. A job reads the pixels where they are, the raw capture it came from
+// stays referenced on the main thread until the encode is done and is never written to in the meantime, see reads().
+class CSnapshotWriter {
+  public:
+    ~CSnapshotWriter();
+
+    // png or jpeg after the extension of path
+    static bool        supportsPath(const std::string& path);
+    // $XDG_PICTURES_DIR, ~/Pictures or the working directory, with a timestamped name
+    static std::string defaultPath(const std::string& what, const std::string& extension);
+
+    // encodes view to path in the background. keepAlive owns the memory of view, pixels may hold it instead
+    void               save(const SRawView& view, SP<SPoolBuffer> keepAlive, std::vector<uint32_t>&& pixels, const std::string& path);
+
+    // a job still reads from this buffer, so nothing may be copied into it
+    bool               reads(const SPoolBuffer* buffer) const;
+    size_t             pending() const;
+
+  private:
+    struct SJob {
+        uint64_t              id = 0;
+        std::thread           thread;
+        SP<SPoolBuffer>       keepAlive;
+        std::vector<uint32_t> pixels;
+    };
+
+    void                               onDone(uint64_t id, const std::string& path, const std::string& error, double ms);
+
+    std::vector<std::unique_ptr<SJob>> m_vJobs;
+    uint64_t                           m_iNextID = 1;
+};
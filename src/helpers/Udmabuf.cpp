@@ -0,0 +1,59 @@
+#include "Udmabuf.hpp"
+
+#include <format>
+#include <sys/ioctl.h>
+#include <linux/udmabuf.h>
+
+CUdmabuf::CUdmabuf() {
+    m_iFD = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+
+    if (m_iFD < 0)
+        throw std::runtime_error(std::format("can't open /dev/udmabuf: {}", strerror(errno)));
+}
+
+CUdmabuf::~CUdmabuf() {
+    if (m_iFD >= 0)
+        close(m_iFD);
+}
+
+bool CUdmabuf::allocate(size_t size, int& dmabuf, void*& data, size_t& mapped) {
+    const size_t PAGE = sysconf(_SC_PAGESIZE);
+    const size_t SIZE = (size + PAGE - 1) / PAGE * PAGE;
+
+    // udmabuf only takes memfds that can't shrink under it
+    const int MEMFD = memfd_create("hyprmagnifier-capture", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (MEMFD < 0) {
+        Debug::log(ERR, "udmabuf: memfd_create failed: %s", strerror(errno));
+        return false;
+    }
+
+    if (ftruncate(MEMFD, SIZE) < 0 || fcntl(MEMFD, F_ADD_SEALS, F_SEAL_SHRINK) < 0) {
+        Debug::log(ERR, "udmabuf: can't size and seal the memfd: %s", strerror(errno));
+        close(MEMFD);
+        return false;
+    }
+
+    udmabuf_create create = {.memfd = (uint32_t)MEMFD, .flags = UDMABUF_FLAGS_CLOEXEC, .offset = 0, .size = SIZE};
+
+    dmabuf = ioctl(m_iFD, UDMABUF_CREATE, &create);
+    if (dmabuf < 0) {
+        Debug::log(ERR, "udmabuf: UDMABUF_CREATE failed: %s", strerror(errno));
+        close(MEMFD);
+        return false;
+    }
+
+    // the memfd mapping is the same pages the dmabuf hands out, the fd itself isn't needed after this
+    data = mmap(nullptr, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, MEMFD, 0);
+    close(MEMFD);
+
+    if (data == MAP_FAILED) {
+        Debug::log(ERR, "udmabuf: mmap failed: %s", strerror(errno));
+        close(dmabuf);
+        dmabuf = -1;
+        data   = nullptr;
+        return false;
+    }
+
+    mapped = SIZE;
+    return true;
+}
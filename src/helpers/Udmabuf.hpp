@@ -0,0 +1,18 @@
+#pragma once
+
+#include "../defines.hpp"
+
+// Turns memfds into dmabufs through /dev/udmabuf, so a buffer the compositor imports with zwp_linux_dmabuf_v1 needs
+// no GPU to allocate and stays plain memory for the CPU to read.
+class CUdmabuf {
+  public:
+    // throws std::runtime_error if /dev/udmabuf can't be opened
+    CUdmabuf();
+    ~CUdmabuf();
+
+    // maps a new udmabuf of at least size bytes into data, false if the kernel refused. dmabuf stays with the caller
+    bool allocate(size_t size, int& dmabuf, void*& data, size_t& mapped);
+
+  private:
+    int m_iFD = -1;
+};
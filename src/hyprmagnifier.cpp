@@ -1,16 +1,18 @@
 #include "hyprmagnifier.hpp"
 #include <csignal>
-
-static void sigHandler(int sig) {
-    g_pHyprmagnifier->m_vLayerSurfaces.clear();
-    exit(0);
-}
+#include <format>
+#include <sys/file.h>
 
 void CHyprmagnifier::init() {
+    m_tStartup = std::chrono::steady_clock::now();
+
     m_pXKBContext = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
     if (!m_pXKBContext)
         Debug::log(ERR, "Failed to create xkb context");
 
+    m_pLatencyTracker          = std::make_unique<CLatencyTracker>();
+    m_pLatencyTracker->m_bLive = m_bTrackLatency;
+
     m_pWLDisplay = wl_display_connect(nullptr);
 
     if (!m_pWLDisplay) {
@@ -19,7 +21,21 @@ void CHyprmagnifier::init() {
         return;
     }
 
-    signal(SIGTERM, sigHandler);
+    traceStartup("connect");
+
+    // signals are read from a signalfd on the loop thread, so handling them can't race the render path
+    m_pEventLoop = std::make_unique<CEventLoop>();
+    m_pEventLoop->addSignal(SIGTERM, [this]() { m_pEventLoop->stop(); });
+    m_pEventLoop->addSignal(SIGINT, [this]() { m_pEventLoop->stop(); });
+    m_pEventLoop->addSignal(SIGUSR1, [this]() { printMemoryStats(); });
+    if (m_bDaemon) {
+        m_pEventLoop->addSignal(SIGUSR2, [this]() {
+            if (m_bActive)
+                deactivate();
+            else
+                activate();
+        });
+    }
 
     m_pRegistry = makeShared<CCWlRegistry>((wl_proxy*)wl_display_get_registry(m_pWLDisplay));
     m_pRegistry->setGlobal([this](CCWlRegistry* r, uint32_t name, const char* interface, uint32_t version) {
@@ -27,6 +43,10 @@ void CHyprmagnifier::init() {
             m_pCompositor = makeShared<CCWlCompositor>((wl_proxy*)wl_registry_bind((wl_registry*)m_pRegistry->resource(), name, &wl_compositor_interface, 4));
         } else if (strcmp(interface, wl_shm_interface.name) == 0) {
             m_pSHM = makeShared<CCWlShm>((wl_proxy*)wl_registry_bind((wl_registry*)m_pRegistry->resource(), name, &wl_shm_interface, 1));
+            m_pSHM->setFormat([this](CCWlShm* r, uint32_t format) {
+                if (format == WL_SHM_FORMAT_XRGB2101010)
+                    m_bSHM2101010 = true;
+            });
         } else if (strcmp(interface, wl_output_interface.name) == 0) {
             m_mtTickMutex.lock();
 
@@ -35,12 +55,14 @@ void CHyprmagnifier::init() {
                                           makeShared<CCWlOutput>((wl_proxy*)wl_registry_bind((wl_registry*)m_pRegistry->resource(), name, &wl_output_interface, 4))))
                                       .get();
             PMONITOR->wayland_name = name;
+            PMONITOR->initXDGOutput();
 
             m_mtTickMutex.unlock();
         } else if (strcmp(interface, zwlr_layer_shell_v1_interface.name) == 0) {
             m_pLayerShell = makeShared<CCZwlrLayerShellV1>((wl_proxy*)wl_registry_bind((wl_registry*)m_pRegistry->resource(), name, &zwlr_layer_shell_v1_interface, 1));
         } else if (strcmp(interface, wl_seat_interface.name) == 0) {
-            m_pSeat = makeShared<CCWlSeat>((wl_proxy*)wl_registry_bind((wl_registry*)m_pRegistry->resource(), name, &wl_seat_interface, 1));
+            // v4 for repeat_info
+            m_pSeat = makeShared<CCWlSeat>((wl_proxy*)wl_registry_bind((wl_registry*)m_pRegistry->resource(), name, &wl_seat_interface, std::min(version, 4u)));
 
             m_pSeat->setCapabilities([this](CCWlSeat* seat, uint32_t caps) {
                 if (caps & WL_SEAT_CAPABILITY_POINTER) {
@@ -65,8 +87,10 @@ void CHyprmagnifier::init() {
             });
 
         } else if (strcmp(interface, zwlr_screencopy_manager_v1_interface.name) == 0) {
-            m_pScreencopyMgr =
-                makeShared<CCZwlrScreencopyManagerV1>((wl_proxy*)wl_registry_bind((wl_registry*)m_pRegistry->resource(), name, &zwlr_screencopy_manager_v1_interface, 1));
+            // v3 for linux_dmabuf offers, never above what the generated interface can demarshal
+            m_iScreencopyVersion = std::min(version, (uint32_t)zwlr_screencopy_manager_v1_interface.version);
+            m_pScreencopyMgr     = makeShared<CCZwlrScreencopyManagerV1>(
+                (wl_proxy*)wl_registry_bind((wl_registry*)m_pRegistry->resource(), name, &zwlr_screencopy_manager_v1_interface, m_iScreencopyVersion));
         } else if (strcmp(interface, wp_cursor_shape_manager_v1_interface.name) == 0) {
             m_pCursorShapeMgr =
                 makeShared<CCWpCursorShapeManagerV1>((wl_proxy*)wl_registry_bind((wl_registry*)m_pRegistry->resource(), name, &wp_cursor_shape_manager_v1_interface, 1));
@@ -75,11 +99,21 @@ void CHyprmagnifier::init() {
                 makeShared<CCWpFractionalScaleManagerV1>((wl_proxy*)wl_registry_bind((wl_registry*)m_pRegistry->resource(), name, &wp_fractional_scale_manager_v1_interface, 1));
         } else if (strcmp(interface, wp_viewporter_interface.name) == 0) {
             m_pViewporter = makeShared<CCWpViewporter>((wl_proxy*)wl_registry_bind((wl_registry*)m_pRegistry->resource(), name, &wp_viewporter_interface, 1));
+        } else if (strcmp(interface, zxdg_output_manager_v1_interface.name) == 0) {
+            m_pXDGOutputMgr = makeShared<CCZxdgOutputManagerV1>((wl_proxy*)wl_registry_bind((wl_registry*)m_pRegistry->resource(), name, &zxdg_output_manager_v1_interface, 1));
+        } else if (strcmp(interface, zwp_linux_dmabuf_v1_interface.name) == 0) {
+            m_pLinuxDmabuf =
+                makeShared<CCZwpLinuxDmabufV1>((wl_proxy*)wl_registry_bind((wl_registry*)m_pRegistry->resource(), name, &zwp_linux_dmabuf_v1_interface, std::min(version, 3u)));
+        } else if (strcmp(interface, wp_presentation_interface.name) == 0) {
+            m_pPresentation = makeShared<CCWpPresentation>((wl_proxy*)wl_registry_bind((wl_registry*)m_pRegistry->resource(), name, &wp_presentation_interface, 1));
+            m_pPresentation->setClockId([this](CCWpPresentation* r, uint32_t clockId) { m_pLatencyTracker->setClock((clockid_t)clockId); });
         }
     });
 
     wl_display_roundtrip(m_pWLDisplay);
 
+    traceStartup("globals bound");
+
     if (!m_pCursorShapeMgr)
         Debug::log(ERR, "cursor_shape_v1 not supported, cursor won't be affected");
 
@@ -96,35 +130,401 @@ void CHyprmagnifier::init() {
         Debug::log(WARN, "wp_viewporter not supported, fractional scaling won't work");
         m_bNoFractional = true;
     }
+    if (!m_pPresentation && m_bTrackLatency)
+        Debug::log(WARN, "wp_presentation not supported, latency can't be measured");
+
+    // captures go into udmabufs where the compositor can import them, which saves it the copy into shm. Anything
+    // missing here, or the first failure later, keeps them on shm
+    if (!m_bNoDmabuf && m_pLinuxDmabuf && m_iScreencopyVersion >= 3) {
+        try {
+            m_pUdmabuf = std::make_unique<CUdmabuf>();
+        } catch (std::exception& e) { Debug::log(LOG, "Capturing through shm, %s", e.what()); }
+    } else if (!m_bNoDmabuf)
+        Debug::log(LOG, "Capturing through shm, %s", m_pLinuxDmabuf ? "zwlr_screencopy_v1 is older than v3" : "zwp_linux_dmabuf_v1 not supported");
+
+    // the layout only matters for a lens that spans outputs, so the positions can arrive along with the first configures
+    if (m_pXDGOutputMgr) {
+        for (auto& m : m_vMonitors) {
+            m->initXDGOutput();
+        }
+    } else
+        Debug::log(WARN, "xdg_output not supported, the layout of outputs comes from wl_output.geometry");
+
+    if (m_bDaemon && !writePidFile())
+        exit(1);
+
+    m_pIPC = std::make_unique<CIPCServer>(getRuntimePath("hyprmagnifier.sock"), m_pEventLoop.get());
+
+    if (!m_szStreamPath.empty()) {
+        const auto FORMAT = m_szStreamFormat.empty() ? CLensStream::formatFor(m_szStreamPath) : m_szStreamFormat == "y4m" ? STREAM_Y4M : STREAM_RAW;
+        try {
+            m_pStream = std::make_unique<CLensStream>(m_szStreamPath, FORMAT, m_iLiveHz ? m_iLiveHz : 60);
+        } catch (std::exception& e) {
+            Debug::log(CRIT, "Failed to start the stream: %s", e.what());
+            exit(1);
+        }
+    }
+
+    initTimers();
 
+    m_bActive = !m_bDaemon;
+
+    // every capture is requested before the first layer surface is mapped, so the copies and the configures
+    // are in flight together and nothing waits on a roundtrip. Whatever arrives last renders the first frame.
     for (auto& m : m_vMonitors) {
-        m_vLayerSurfaces.emplace_back(std::make_unique<CLayerSurface>(m.get()));
+        m_vLayerSurfaces.emplace_back(std::make_unique<CLayerSurface>(m.get(), false));
 
-        m_pLastSurface = m_vLayerSurfaces.back().get();
+        m->pLS = m_vLayerSurfaces.back().get();
+        // a daemon only learns the capture format here, to have every buffer allocated before the first activation
+        m->capture(m_bDaemon);
+    }
+
+    if (m_bActive) {
+        for (auto& ls : m_vLayerSurfaces) {
+            ls->map();
+        }
 
-        m->pSCFrame = makeShared<CCZwlrScreencopyFrameV1>(m_pScreencopyMgr->sendCaptureOutput(false, m->output->resource()));
-        m->pLS      = m_vLayerSurfaces.back().get();
-        m->initSCFrame();
+        m_pLastSurface = m_vLayerSurfaces.empty() ? nullptr : m_vLayerSurfaces.back().get();
     }
 
-    wl_display_roundtrip(m_pWLDisplay);
+    wl_display_flush(m_pWLDisplay);
+
+    if (m_bDaemon)
+        Debug::log(LOG, "hyprmagnifier daemon ready, send SIGUSR2 or run hyprmagnifier --activate to toggle the lens");
+
+    m_pEventLoop->run(m_pWLDisplay);
+
+    teardown();
+}
+
+void CHyprmagnifier::initTimers() {
+    m_iRepeatTimer = m_pEventLoop->addTimer(0, 0, [this]() { onZoomKey(m_dRepeatStep); });
 
-    while (m_bRunning && wl_display_dispatch(m_pWLDisplay) != -1) {
-        //renderSurface(m_pLastSurface);
+    if (m_iIdleTimeoutMs)
+        m_iIdleTimer = m_pEventLoop->addTimer(m_bActive ? m_iIdleTimeoutMs : 0, 0, [this]() { onIdle(); });
+
+    if (m_iLiveHz) {
+        const uint64_t INTERVAL = std::max(1000 / m_iLiveHz, 1u);
+        m_iLiveTimer            = m_pEventLoop->addTimer(INTERVAL, INTERVAL, [this]() { onLiveTick(); });
     }
 
-    if (m_pWLDisplay) {
-        wl_display_disconnect(m_pWLDisplay);
-        m_pWLDisplay = nullptr;
+    m_iBackgroundTimer = m_pEventLoop->addTimer(0, 0, [this]() {
+        m_bBackgroundPending = false;
+        if (m_pLastSurface)
+            refreshNeighbours(m_pLastSurface);
+    });
+}
+
+void CHyprmagnifier::onZoomKey(double step) {
+    m_dPendingAxis += step;
+
+    markInput();
+    scheduleFrame();
+}
+
+// leaves a copy of the live lens where it is, returns false without one
+bool CHyprmagnifier::pinLens() {
+    if (!m_pLastSurface)
+        return false;
+
+    const auto& PINNED = m_vPinnedLenses.emplace_back(liveLens());
+
+    Debug::log(LOG, "Pinned a lens at %.0fx%.0f in the layout (%zu pinned)", PINNED.center.x, PINNED.center.y, m_vPinnedLenses.size());
+
+    markDirty();
+    return true;
+}
+
+// replaces the frozen image of the output under the pointer, the other outputs keep theirs. The surface commits an
+// empty frame first and the capture goes out once that is up, see renderSurface. Lenses on other outputs keep reading
+// the old image meanwhile, the copy lands in the spare capture buffer and the image only switches over once it is
+// ready, between two frames. Returns false without an output or while a capture of it is still in flight
+bool CHyprmagnifier::recapture() {
+    if (!m_pLastSurface || !m_pLastSurface->captured || m_pLastSurface->recapture != RECAPTURE_NONE || m_pLastSurface->m_pMonitor->pSCFrame)
+        return false;
+
+    Debug::log(LOG, "Recapturing %s", m_pLastSurface->m_pMonitor->name.c_str());
+
+    m_pLastSurface->recapture = RECAPTURE_HIDING;
+    if (!m_pLastSurface->frameCallback)
+        m_pLastSurface->markDirty();
+
+    return true;
+}
+
+// the live lens where the pointer is, its size and zoom taken from the buffer and the capture of the pointer output
+SLayoutLens CHyprmagnifier::liveLens() {
+    const auto SCALE      = bufferScale(m_pLastSurface);
+    const auto IMAGESCALE = m_pLastSurface->captured && m_pLastSurface->image ? m_pLastSurface->image->size() / m_pLastSurface->m_pMonitor->size : SCALE;
+
+    return {.center = m_pLastSurface->m_pMonitor->position + m_vPosition.floor(), .size = m_vSize / SCALE, .zoom = m_dZoom * SCALE.x / IMAGESCALE.x, .filter = m_pFilter};
+}
+
+// buffer pixels per logical pixel of a surface
+Vector2D CHyprmagnifier::bufferScale(CLayerSurface* pSurface) {
+    if (!pSurface->buffers[0])
+        return {pSurface->fractionalScale, pSurface->fractionalScale};
+
+    return pSurface->buffers[0]->pixelSize / pSurface->m_pMonitor->size;
+}
+
+// removes the newest pinned lens, or all of them
+bool CHyprmagnifier::unpinLens(bool all) {
+    if (m_vPinnedLenses.empty())
+        return false;
+
+    if (all)
+        m_vPinnedLenses.clear();
+    else
+        m_vPinnedLenses.pop_back();
+
+    markDirty();
+    return true;
+}
+
+// replaces the filter of the live lens, "none" or an empty spec removes it. Throws std::invalid_argument for a bad spec
+void CHyprmagnifier::setFilter(const std::string& spec) {
+    m_pFilter = spec.empty() || spec == "none" ? nullptr : std::make_shared<CColorFilter>(spec);
+
+    Debug::log(LOG, "Lens filter: %s", m_pFilter ? m_pFilter->spec().c_str() : "none");
+
+    markDirty();
+}
+
+// steps the live lens through a few common filters, starting over from none after a custom spec
+void CHyprmagnifier::cycleFilter() {
+    static constexpr std::array<const char*, 8> PRESETS = {"none", "invert", "greyscale", "contrast", "sharpen", "fix-deutan", "fix-protan", "fix-tritan"};
+
+    const std::string CURRENT = m_pFilter ? m_pFilter->spec() : "none";
+    const auto        IT      = std::ranges::find(PRESETS, CURRENT);
+
+    setFilter(IT == PRESETS.end() || IT + 1 == PRESETS.end() ? PRESETS[0] : *(IT + 1));
+}
+
+// hands the live lens as shown, or the whole capture under it, to the snapshot writer. Returns the path written to,
+// empty without a capture
+std::string CHyprmagnifier::snapshot(bool full, const std::string& path) {
+    if (!m_pLastSurface || !m_pLastSurface->captured || !m_pLastSurface->image)
+        return "";
+
+    const auto& IMAGE = m_pLastSurface->image;
+    const auto  PATH  = path.empty() ? CSnapshotWriter::defaultPath(full ? "full" : "lens", m_szSnapshotFormat) : path;
+
+    // the raw capture is encoded in place, it just can't be copied into again until the writer lets go of it
+    if (full) {
+        m_pSnapshots->save(IMAGE->rawView(), IMAGE->raw(), {}, PATH);
+        return PATH;
     }
+
+    // a lens is small, so it is sampled and filtered here the way drawLens does and the copy goes to the writer
+    const int             W = m_vSize.x, H = m_vSize.y;
+    std::vector<uint32_t> pixels((size_t)W * H, 0xFF000000);
+    const auto            CENTER = m_vPosition.floor() / m_pLastSurface->m_pMonitor->size * IMAGE->size();
+
+    IMAGE->sample(pixels.data(), W * sizeof(uint32_t), 0, 0, W, H, CENTER - m_vSize / 2.0 * m_dZoom, m_dZoom);
+    if (IMAGE->highPrecision())
+        Formats::info(WL_SHM_FORMAT_XRGB2101010)->to8Bit((const uint8_t*)pixels.data(), 4, pixels.data(), W * H);
+    if (m_pFilter)
+        m_pFilter->apply(pixels.data(), W, W, H, false);
+
+    const SRawView VIEW = {.origin = (const uint8_t*)pixels.data(),
+                           .stepX  = 4,
+                           .stepY  = W * 4,
+                           .width  = W,
+                           .height = H,
+                           .format = WL_SHM_FORMAT_ARGB8888,
+                           .to8Bit = Formats::info(WL_SHM_FORMAT_ARGB8888)->to8Bit};
+
+    m_pSnapshots->save(VIEW, nullptr, std::move(pixels), PATH);
+    return PATH;
+}
+
+void CHyprmagnifier::onIdle() {
+    Debug::log(LOG, "No input for %lums, %s", m_iIdleTimeoutMs, m_bDaemon ? "hiding the lens" : "exiting");
+
+    if (m_bDaemon)
+        deactivate();
+    else
+        m_pEventLoop->stop();
+}
+
+// recaptures the output under the lens unless its previous capture is still in flight. The lens goes through the same
+// empty frame as recapture(), a capture with it still up would magnify its own last frame
+void CHyprmagnifier::onLiveTick() {
+    // a full-screen zoom would blank the whole output for every capture
+    if (!m_bActive || !m_pLastSurface || m_bFullscreen)
+        return;
+
+    if (m_pLastSurface->m_pMonitor->pSCFrame || !m_pLastSurface->captured || m_pLastSurface->recapture != RECAPTURE_NONE)
+        return;
+
+    // every other tick under pressure, the timer itself keeps its rate
+    if (m_pGovernor->level() >= QUALITY_CAPTURE && m_iLiveTicks++ % 2)
+        return;
+
+    m_pLastSurface->recapture = RECAPTURE_HIDING;
+    if (!m_pLastSurface->frameCallback)
+        m_pLastSurface->markDirty();
+}
+
+std::string CHyprmagnifier::getStats() {
+    std::string stats = std::format("frames {}", m_iFramesRendered);
+
+    if (m_pLatencyTracker->m_iSamples)
+        stats += std::format("\nlatency last {:.2f}ms avg {:.2f}ms p95 {:.0f}ms max {:.2f}ms ({} frames)", m_pLatencyTracker->m_iLastNs / 1000000.0,
+                             m_pLatencyTracker->averageMs(), m_pLatencyTracker->percentile(0.95), m_pLatencyTracker->m_iMaxNs / 1000000.0, m_pLatencyTracker->m_iSamples);
+
+    stats += std::format("\ncapture {}", m_pUdmabuf ? "dmabuf" : "shm");
+    stats += "\n" + m_pGovernor->report();
+    stats += "\n" + m_pMemoryTracker->report();
+
+    return stats;
+}
+
+void CHyprmagnifier::activate() {
+    if (m_bActive)
+        return;
+
+    m_bActive         = true;
+    m_iActivationTime = m_pLatencyTracker->now();
+    m_tStartup        = std::chrono::steady_clock::now();
+
+    traceStartup("activate");
+
+    m_pEventLoop->updateTimer(m_iIdleTimer, m_iIdleTimeoutMs);
+
+    for (auto& m : m_vMonitors) {
+        m->capture();
+    }
+
+    for (auto& ls : m_vLayerSurfaces) {
+        ls->map();
+    }
+
+    wl_display_flush(m_pWLDisplay);
+}
+
+void CHyprmagnifier::deactivate() {
+    if (!m_bActive)
+        return;
+
+    m_bActive = false;
+
+    for (auto& ls : m_vLayerSurfaces) {
+        ls->unmap();
+    }
+
+    for (auto& m : m_vMonitors) {
+        m->pSCFrame.reset();
+    }
+
+    m_pLastSurface      = nullptr;
+    m_iPendingInputTime = 0;
+    m_bPendingMotion    = false;
+    m_dPendingAxis      = 0.0;
+    m_iRepeatKey        = 0;
+
+    m_pEventLoop->updateTimer(m_iRepeatTimer, 0);
+    m_pEventLoop->updateTimer(m_iIdleTimer, 0);
+}
+
+std::string CHyprmagnifier::getRuntimePath(const char* name) {
+    const auto XDGRUNTIMEDIR = getenv("XDG_RUNTIME_DIR");
+    if (!XDGRUNTIMEDIR)
+        return "";
+
+    return std::string(XDGRUNTIMEDIR) + "/" + name;
+}
+
+bool CHyprmagnifier::writePidFile() {
+    const auto PATH = getRuntimePath("hyprmagnifier.pid");
+    if (PATH.empty()) {
+        Debug::log(CRIT, "XDG_RUNTIME_DIR not set!");
+        return false;
+    }
+
+    // the lock goes with the process however it ends, so a stale file or a reused pid never counts as a daemon
+    const int FD = open(PATH.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (FD < 0) {
+        Debug::log(CRIT, "Can't open %s: %s", PATH.c_str(), strerror(errno));
+        return false;
+    }
+
+    if (flock(FD, LOCK_EX | LOCK_NB) != 0) {
+        Debug::log(CRIT, "Another hyprmagnifier daemon is running");
+        close(FD);
+        return false;
+    }
+
+    const auto PID = std::to_string(getpid()) + "\n";
+    if (ftruncate(FD, 0) != 0 || write(FD, PID.c_str(), PID.size()) != (ssize_t)PID.size()) {
+        close(FD);
+        return false;
+    }
+
+    m_iPidFD = FD;
+    return true;
+}
+
+void CHyprmagnifier::traceStartup(const char* event, const SMonitor* pMonitor) {
+    if (!m_bStartupTrace)
+        return;
+
+    const auto ELAPSED = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_tStartup).count();
+
+    if (pMonitor)
+        Debug::log(INFO, "startup %8.3fms %s on %s", ELAPSED, event, pMonitor->name.c_str());
+    else
+        Debug::log(INFO, "startup %8.3fms %s", ELAPSED, event);
+}
+
+void CHyprmagnifier::printMemoryStats() {
+    Debug::log(NONE, "%s", m_pMemoryTracker->report().c_str());
+}
+
+void CHyprmagnifier::printExitSummary() {
+    if (m_bMemoryStats)
+        printMemoryStats();
+
+    if (m_pStream && m_pStream->open())
+        Debug::log(LOG, "Streamed %lu lens frames, %lu dropped", m_pStream->framesWritten(), m_pStream->framesDropped());
+
+    if (!m_bTrackLatency || !m_pLatencyTracker)
+        return;
+
+    m_pLatencyTracker->printSummary();
+
+    if (!m_szLatencyHistogram.empty() && m_pLatencyTracker->dumpHistogram(m_szLatencyHistogram))
+        Debug::log(LOG, "latency histogram written to %s", m_szLatencyHistogram.c_str());
 }
 
 void CHyprmagnifier::finish(int code) {
-    m_vLayerSurfaces.clear();
+    teardown();
+
+    exit(code);
+}
+
+void CHyprmagnifier::teardown() {
+    printExitSummary();
+
+    m_pIPC.reset();
+    // lets every pending encode finish, they read capture buffers that are about to go
+    m_pSnapshots.reset();
+
+    if (m_iPidFD >= 0) {
+        unlink(getRuntimePath("hyprmagnifier.pid").c_str());
+        close(m_iPidFD);
+        m_iPidFD = -1;
+    }
+
+    for (auto& m : m_vMonitors) {
+        m->joinWorker();
+    }
 
     if (m_pWLDisplay) {
         m_vLayerSurfaces.clear();
         m_vMonitors.clear();
+        m_pUdmabuf.reset();
         m_pCompositor.reset();
         m_pRegistry.reset();
         m_pSHM.reset();
@@ -137,36 +537,50 @@ void CHyprmagnifier::finish(int code) {
         m_pPointer.reset();
         m_pViewporter.reset();
         m_pFractionalMgr.reset();
+        m_pPresentation.reset();
+        m_pLinuxDmabuf.reset();
 
         wl_display_disconnect(m_pWLDisplay);
         m_pWLDisplay = nullptr;
     }
 
-    exit(code);
+    m_pEventLoop.reset();
 }
 
 void CHyprmagnifier::recheckACK() {
     for (auto& ls : m_vLayerSurfaces) {
-        if ((ls->wantsACK || ls->wantsReload) && ls->screenBuffer) {
+        if ((ls->wantsACK || ls->wantsReload) && ls->captured) {
             if (ls->wantsACK)
                 ls->pLayerSurface->sendAckConfigure(ls->ACKSerial);
             ls->wantsACK    = false;
             ls->wantsReload = false;
 
             const auto MONITORSIZE =
-                (ls->screenBuffer && !g_pHyprmagnifier->m_bNoFractional ? ls->m_pMonitor->size * ls->fractionalScale : ls->m_pMonitor->size * ls->m_pMonitor->scale).round();
+                (ls->image && !g_pHyprmagnifier->m_bNoFractional ? ls->m_pMonitor->size * ls->fractionalScale : ls->m_pMonitor->size * ls->m_pMonitor->scale).round();
 
             if (!ls->buffers[0] || ls->buffers[0]->pixelSize != MONITORSIZE) {
                 Debug::log(TRACE, "making new buffers: size changed to %.0fx%.0f", MONITORSIZE.x, MONITORSIZE.y);
-                ls->buffers[0] = makeShared<SPoolBuffer>(MONITORSIZE, WL_SHM_FORMAT_ARGB8888, MONITORSIZE.x * 4);
-                ls->buffers[1] = makeShared<SPoolBuffer>(MONITORSIZE, WL_SHM_FORMAT_ARGB8888, MONITORSIZE.x * 4);
+                ls->buffers[0] = makeShared<SPoolBuffer>(MONITORSIZE, WL_SHM_FORMAT_ARGB8888, MONITORSIZE.x * 4, MEM_OUTPUT, ls->m_pMonitor->name);
+                ls->buffers[1] = makeShared<SPoolBuffer>(MONITORSIZE, WL_SHM_FORMAT_ARGB8888, MONITORSIZE.x * 4, MEM_OUTPUT, ls->m_pMonitor->name);
             }
+
+            if (!ls->rendered)
+                renderSurface(ls.get());
         }
     }
 
     markDirty();
 }
 
+void CHyprmagnifier::markInput() {
+    // inputs coalesced into one frame waited since the first of them
+    if (m_pPresentation && !m_iPendingInputTime)
+        m_iPendingInputTime = m_pLatencyTracker->now();
+
+    if (m_bActive)
+        m_pEventLoop->updateTimer(m_iIdleTimer, m_iIdleTimeoutMs);
+}
+
 void CHyprmagnifier::markDirty() {
     for (auto& ls : m_vLayerSurfaces) {
         if (ls->frameCallback)
@@ -176,14 +590,29 @@ void CHyprmagnifier::markDirty() {
     }
 }
 
-SP<SPoolBuffer> CHyprmagnifier::getBufferForLS(CLayerSurface* pLS) {
+bool CHyprmagnifier::use10Bit() const {
+    // live frames never cover the whole output, see renderSurface
+    return m_bSHM2101010 && !m_bNo10Bit && !m_iLiveHz;
+}
+
+SP<SPoolBuffer> CHyprmagnifier::getBufferForLS(CLayerSurface* pLS, bool highPrecision) {
     SP<SPoolBuffer> returns = nullptr;
 
+    auto&           buffers = highPrecision ? pLS->buffers10Bit : pLS->buffers;
+
+    // the 10-bit pair follows the size recheckACK picked for the 8-bit one
+    if (highPrecision && pLS->buffers[0] && (!buffers[0] || buffers[0]->pixelSize != pLS->buffers[0]->pixelSize)) {
+        const auto SIZE = pLS->buffers[0]->pixelSize;
+        for (auto& b : buffers) {
+            b = makeShared<SPoolBuffer>(SIZE, WL_SHM_FORMAT_XRGB2101010, SIZE.x * 4, MEM_OUTPUT, pLS->m_pMonitor->name);
+        }
+    }
+
     for (auto i = 0; i < 2; ++i) {
-        if (!pLS->buffers[i] || pLS->buffers[i]->busy)
+        if (!buffers[i] || buffers[i]->busy)
             continue;
 
-        returns = pLS->buffers[i];
+        returns = buffers[i];
     }
 
     return returns;
@@ -202,6 +631,15 @@ bool CHyprmagnifier::setCloexec(const int& FD) {
     return true;
 }
 
+// the first sign that dmabuf captures don't work here keeps every later one on shm
+void CHyprmagnifier::disableDmabuf(const char* reason) {
+    if (!m_pUdmabuf)
+        return;
+
+    Debug::log(WARN, "Capturing through shm from now on: %s", reason);
+    m_pUdmabuf.reset();
+}
+
 int CHyprmagnifier::createPoolFile(size_t size, std::string& name) {
     const auto XDGRUNTIMEDIR = getenv("XDG_RUNTIME_DIR");
     if (!XDGRUNTIMEDIR) {
@@ -232,210 +670,577 @@ int CHyprmagnifier::createPoolFile(size_t size, std::string& name) {
     return FD;
 }
 
-void CHyprmagnifier::convertBuffer(SP<SPoolBuffer> pBuffer) {
-    switch (pBuffer->format) {
-        case WL_SHM_FORMAT_ARGB8888:
-        case WL_SHM_FORMAT_XRGB8888: break;
-        case WL_SHM_FORMAT_ABGR8888:
-        case WL_SHM_FORMAT_XBGR8888: {
-            uint8_t* data = (uint8_t*)pBuffer->data;
-
-            for (int y = 0; y < pBuffer->pixelSize.y; ++y) {
-                for (int x = 0; x < pBuffer->pixelSize.x; ++x) {
-                    struct pixel {
-                        // little-endian ARGB
-                        unsigned char blue;
-                        unsigned char green;
-                        unsigned char red;
-                        unsigned char alpha;
-                    }* px = (struct pixel*)(data + (y * (int)pBuffer->pixelSize.x * 4) + (x * 4));
-
-                    std::swap(px->red, px->blue);
-                }
-            }
-        } break;
-        case WL_SHM_FORMAT_XRGB2101010:
-        case WL_SHM_FORMAT_XBGR2101010: {
-            uint8_t*   data = (uint8_t*)pBuffer->data;
+void CHyprmagnifier::renderSurface(CLayerSurface* pSurface, bool forceInactive) {
+    // the image belongs to the conversion worker until the first capture is processed
+    if (!pSurface->captured || !pSurface->image)
+        return;
 
-            const bool FLIP = pBuffer->format == WL_SHM_FORMAT_XBGR2101010;
+    // the empty frame is up, so the capture sees the desktop alone. Nothing is drawn until onCaptureProcessed
+    if (pSurface->recapture == RECAPTURE_HIDDEN) {
+        pSurface->recapture = RECAPTURE_CAPTURING;
+        pSurface->m_pMonitor->capture();
+        return;
+    }
 
-            for (int y = 0; y < pBuffer->pixelSize.y; ++y) {
-                for (int x = 0; x < pBuffer->pixelSize.x; ++x) {
-                    uint32_t* px = (uint32_t*)(data + (y * (int)pBuffer->pixelSize.x * 4) + (x * 4));
+    if (pSurface->recapture == RECAPTURE_CAPTURING)
+        return;
 
-                    // conv to 8 bit
-                    uint8_t R = (uint8_t)std::round((255.0 * (((*px) & 0b00000000000000000000001111111111) >> 0) / 1023.0));
-                    uint8_t G = (uint8_t)std::round((255.0 * (((*px) & 0b00000000000011111111110000000000) >> 10) / 1023.0));
-                    uint8_t B = (uint8_t)std::round((255.0 * (((*px) & 0b00111111111100000000000000000000) >> 20) / 1023.0));
-                    uint8_t A = (uint8_t)std::round((255.0 * (((*px) & 0b11000000000000000000000000000000) >> 30) / 3.0));
+    const auto& IMAGE = pSurface->image;
+    const bool  LENS  = pSurface == m_pLastSurface && !forceInactive;
+    const bool  HIDE  = pSurface->recapture == RECAPTURE_HIDING;
 
-                    // write 8-bit values
-                    *px = ((FLIP ? B : R) << 0) + (G << 8) + ((FLIP ? R : B) << 16) + (A << 24);
-                }
-            }
-        } break;
-        default: {
-            Debug::log(CRIT, "Unsupported format %i", pBuffer->format);
-        }
-            g_pHyprmagnifier->finish(1);
-    }
-}
-
-// Mallocs a new buffer, which needs to be free'd!
-void* CHyprmagnifier::convert24To32Buffer(SP<SPoolBuffer> pBuffer) {
-    uint8_t* newBuffer       = (uint8_t*)malloc((size_t)pBuffer->pixelSize.x * pBuffer->pixelSize.y * 4);
-    int      newBufferStride = pBuffer->pixelSize.x * 4;
-    uint8_t* oldBuffer       = (uint8_t*)pBuffer->data;
-
-    switch (pBuffer->format) {
-        case WL_SHM_FORMAT_BGR888: {
-            for (int y = 0; y < pBuffer->pixelSize.y; ++y) {
-                for (int x = 0; x < pBuffer->pixelSize.x; ++x) {
-                    struct pixel3 {
-                        // little-endian RGB
-                        unsigned char blue;
-                        unsigned char green;
-                        unsigned char red;
-                    }* srcPx = (struct pixel3*)(oldBuffer + (y * pBuffer->stride) + (x * 3));
-                    struct pixel4 {
-                        // little-endian ARGB
-                        unsigned char blue;
-                        unsigned char green;
-                        unsigned char red;
-                        unsigned char alpha;
-                    }* dstPx = (struct pixel4*)(newBuffer + (y * newBufferStride) + (x * 4));
-                    *dstPx   = {.blue = srcPx->red, .green = srcPx->green, .red = srcPx->blue, .alpha = 0xFF};
-                }
-            }
-        } break;
-        case WL_SHM_FORMAT_RGB888: {
-            for (int y = 0; y < pBuffer->pixelSize.y; ++y) {
-                for (int x = 0; x < pBuffer->pixelSize.x; ++x) {
-                    struct pixel3 {
-                        // big-endian RGB
-                        unsigned char red;
-                        unsigned char green;
-                        unsigned char blue;
-                    }* srcPx = (struct pixel3*)(oldBuffer + (y * pBuffer->stride) + (x * 3));
-                    struct pixel4 {
-                        // big-endian ARGB
-                        unsigned char alpha;
-                        unsigned char red;
-                        unsigned char green;
-                        unsigned char blue;
-                    }* dstPx = (struct pixel4*)(newBuffer + (y * newBufferStride) + (x * 4));
-                    *dstPx   = {.alpha = 0xFF, .red = srcPx->red, .green = srcPx->green, .blue = srcPx->blue};
-                }
-            }
-        } break;
-        default: {
-            Debug::log(CRIT, "Unsupported format for 24bit buffer %i", pBuffer->format);
-        }
-            g_pHyprmagnifier->finish(1);
-    }
-    return newBuffer;
-}
+    // the output under the pointer shows nothing but the magnified capture, see CFullscreenZoom
+    const bool FULLSCREEN = m_bFullscreen && m_bActive && LENS && !HIDE;
 
-void CHyprmagnifier::renderSurface(CLayerSurface* pSurface, bool forceInactive) {
-    const auto PBUFFER = getBufferForLS(pSurface);
+    // live captures keep changing underneath, so only the lenses are drawn over the real desktop
+    const bool PREVIEW = !FULLSCREEN && !m_iLiveHz && !HIDE && (LENS || m_bRenderInactive);
+
+    // 2101010 has no alpha worth using, so only frames that cover the whole output keep 10 bits
+    const bool HIGHPRECISION = IMAGE->highPrecision() && (PREVIEW || FULLSCREEN);
+
+    const auto PBUFFER = getBufferForLS(pSurface, HIGHPRECISION);
 
-    if (!PBUFFER || !pSurface->screenBuffer) {
+    if (!PBUFFER) {
         // Spammy log, doesn't matter.
-        // Debug::log(ERR, PBUFFER ? "renderSurface: pSurface->screenBuffer null" : "renderSurface: PBUFFER null");
+        // Debug::log(ERR, "renderSurface: PBUFFER null");
         return;
     }
 
-    PBUFFER->surface =
-        cairo_image_surface_create_for_data((unsigned char*)PBUFFER->data, CAIRO_FORMAT_ARGB32, PBUFFER->pixelSize.x, PBUFFER->pixelSize.y, PBUFFER->pixelSize.x * 4);
+    const auto BEGIN = std::chrono::steady_clock::now();
 
-    PBUFFER->cairo = cairo_create(PBUFFER->surface);
+    if (LENS) {
+        latchInput();
 
-    const auto PCAIRO = PBUFFER->cairo;
+        pSurface->inputTime = m_iPendingInputTime;
+        m_iPendingInputTime = 0;
+    }
 
-    cairo_save(PCAIRO);
+    SDrawnFrame                           frame = {.generation = IMAGE->generation(), .preview = PREVIEW, .size = PBUFFER->pixelSize};
+    std::vector<std::vector<SLensSource>> sources;
+    const auto                            SCALE = PBUFFER->pixelSize / pSurface->m_pMonitor->size;
+
+    // every lens that reaches this output, wherever its center is, sampled from every capture under what it magnifies
+    const auto place = [&](const SLayoutLens& lens, bool live, int readout) {
+        SLensDraw draw = {.center  = (lens.center - pSurface->m_pMonitor->position) * SCALE,
+                          .size    = (lens.size * SCALE).round(),
+                          .zoom    = lens.zoom * IMAGE->size().x / pSurface->m_pMonitor->size.x / SCALE.x,
+                          .shape   = m_eLensShape,
+                          .filter  = lens.filter,
+                          .readout = readout,
+                          .live    = live,
+                          .reduced = lens.filter && m_pGovernor->level() >= QUALITY_FILTER};
+
+        // the pointer goes where the lens puts the point under it, as big as it would be at that magnification
+        if (live && !m_bNoLensCursor) {
+            const auto POINTER = m_pLastSurface->m_pMonitor->position + m_vLastCoords;
+            draw.cursor        = std::round(CCursorSprite::nominalSize() * SCALE.x / lens.zoom);
+            draw.hotspot       = (lens.center + (POINTER - lens.center) / lens.zoom - pSurface->m_pMonitor->position) * SCALE;
+        }
 
-    cairo_set_source_rgba(PCAIRO, 0, 0, 0, 0);
+        const auto BOX = CLensMask::box(draw, m_dBorderWidth);
+        if (BOX.x >= PBUFFER->pixelSize.x || BOX.y >= PBUFFER->pixelSize.y || BOX.x + BOX.w <= 0 || BOX.y + BOX.h <= 0)
+            return;
 
-    cairo_rectangle(PCAIRO, 0, 0, PBUFFER->pixelSize.x, PBUFFER->pixelSize.y);
-    cairo_fill(PCAIRO);
+        auto lensSources = this->lensSources(pSurface, lens, draw, SCALE);
+        for (const auto& source : lensSources) {
+            if (source.image != IMAGE.get())
+                draw.sources = draw.sources * 31 + source.image->generation();
+        }
 
-    if (pSurface == m_pLastSurface && !forceInactive) {
-        const auto SCALEBUFS      = pSurface->screenBuffer->pixelSize / PBUFFER->pixelSize;
-        const auto POSABS         = m_vPosition.floor() / pSurface->m_pMonitor->size;
-        const auto MAGNIFIERPOS   = POSABS * PBUFFER->pixelSize;
+        frame.lenses.push_back(draw);
+        sources.push_back(std::move(lensSources));
+    };
 
-        Debug::log(TRACE, "renderSurface: scalebufs %.2fx%.2f", SCALEBUFS.x, SCALEBUFS.y);
+    // pinned lenses in the order they were pinned, the live one on top
+    for (const auto& pinned : m_vPinnedLenses) {
+        if (!HIDE && !FULLSCREEN)
+            place(pinned, false, 0);
+    }
 
-        const auto PATTERNPRE = cairo_pattern_create_for_surface(pSurface->screenBuffer->surface);
-        cairo_pattern_set_filter(PATTERNPRE, CAIRO_FILTER_BILINEAR);
-        cairo_matrix_t matrixPre;
-        cairo_matrix_init_identity(&matrixPre);
-        cairo_matrix_scale(&matrixPre, SCALEBUFS.x, SCALEBUFS.y);
-        cairo_pattern_set_matrix(PATTERNPRE, &matrixPre);
-        cairo_set_source(PCAIRO, PATTERNPRE);
-        cairo_paint(PCAIRO);
+    if (m_bActive && m_pLastSurface && !forceInactive && !HIDE && !m_bFullscreen) {
+        // the readout stays on the output of the pointer
+        const int READOUT = !LENS || m_bDisableHexPreview ? 0 : std::round(READOUT_FONT * SCALE.y);
+        place(liveLens(), true, READOUT);
+    }
 
-        cairo_surface_flush(PBUFFER->surface);
-        cairo_pattern_destroy(PATTERNPRE);
-
-        const auto CLICKPOSBUF = MAGNIFIERPOS / PBUFFER->pixelSize * pSurface->screenBuffer->pixelSize;
-
-        const auto PATTERN = cairo_pattern_create_for_surface(pSurface->screenBuffer->surface);
-        cairo_pattern_set_filter(PATTERN, CAIRO_FILTER_NEAREST);
-        cairo_matrix_t matrix;
-        cairo_matrix_init_identity(&matrix);
-        cairo_matrix_translate(&matrix, CLICKPOSBUF.x, CLICKPOSBUF.y);
-        cairo_matrix_scale(&matrix, m_dZoom, m_dZoom);
-        cairo_matrix_translate(&matrix, (-CLICKPOSBUF.x / SCALEBUFS.x), (-CLICKPOSBUF.y / SCALEBUFS.y));
-        cairo_pattern_set_matrix(PATTERN, &matrix);
-        cairo_set_source(PCAIRO, PATTERN);
-        cairo_rectangle(PCAIRO, MAGNIFIERPOS.x - (m_vSize.x / 2.0), MAGNIFIERPOS.y - (m_vSize.y / 2.0), m_vSize.x, m_vSize.y);
-        cairo_clip(PCAIRO);
-        cairo_paint(PCAIRO);
+    // the point under the pointer stays under it. The real pointer is over the output, so none is drawn
+    if (FULLSCREEN) {
+        const auto IMAGESCALE = IMAGE->size() / pSurface->m_pMonitor->size;
+        frame.zoom            = CFullscreenZoom::viewFor(m_vLastCoords * IMAGESCALE, m_vLastCoords * SCALE, m_dZoom, IMAGE->size(), PBUFFER->pixelSize);
+    }
 
-        // -------------- Draw outline --------------
-        const CColor OUTLINECOLOR = {.r=150, .g=150, .b=150, .a=255};
+    // the buffer is repainted relative to its own contents, the surface is damaged relative to the last commit
+    const auto REPAINT = getDamage(PBUFFER->drawn, frame);
 
-        cairo_rectangle(PCAIRO, MAGNIFIERPOS.x - (m_vSize.x / 2.0), MAGNIFIERPOS.y - (m_vSize.y / 2.0), m_vSize.x, m_vSize.y);
-        cairo_set_source_rgba(PCAIRO, OUTLINECOLOR.r / 255.f, OUTLINECOLOR.g / 255.f, OUTLINECOLOR.b / 255.f, OUTLINECOLOR.a / 255.f);
-        cairo_set_line_width(PCAIRO, 2.0);
-        cairo_stroke(PCAIRO);
-        // ------------------------------------------
+    if (FULLSCREEN && !REPAINT.empty()) {
+        if (!m_pFullscreenZoom)
+            m_pFullscreenZoom = std::make_unique<CFullscreenZoom>();
 
-        cairo_surface_flush(PBUFFER->surface);
+        // the other buffer of the pair holds the last frame, what it shows of the same image is copied over instead of
+        // sampled again. The compositor only ever reads it too
+        const auto& PAIR     = HIGHPRECISION ? pSurface->buffers10Bit : pSurface->buffers;
+        const auto  PREVIOUS = PAIR[0] == PBUFFER ? PAIR[1] : PAIR[0];
+        const bool  REUSE    = PREVIOUS && PREVIOUS->drawn.generation == frame.generation && PREVIOUS->drawn.size == frame.size;
 
-        cairo_restore(PCAIRO);
-        cairo_pattern_destroy(PATTERN);
-    } else if (!m_bRenderInactive) {
-        cairo_set_operator(PCAIRO, CAIRO_OPERATOR_SOURCE);
-        cairo_set_source_rgba(PCAIRO, 0, 0, 0, 0);
-        cairo_rectangle(PCAIRO, 0, 0, PBUFFER->pixelSize.x, PBUFFER->pixelSize.y);
-        cairo_fill(PCAIRO);
-    } else {
-        const auto SCALEBUFS  = pSurface->screenBuffer->pixelSize / PBUFFER->pixelSize;
-        const auto PATTERNPRE = cairo_pattern_create_for_surface(pSurface->screenBuffer->surface);
-        cairo_pattern_set_filter(PATTERNPRE, CAIRO_FILTER_BILINEAR);
-        cairo_matrix_t matrixPre;
-        cairo_matrix_init_identity(&matrixPre);
-        cairo_matrix_scale(&matrixPre, SCALEBUFS.x, SCALEBUFS.y);
-        cairo_pattern_set_matrix(PATTERNPRE, &matrixPre);
-        cairo_set_source(PCAIRO, PATTERNPRE);
-        cairo_paint(PCAIRO);
+        if (!m_pFullscreenZoom->render(PBUFFER.get(), IMAGE.get(), REUSE ? PREVIOUS.get() : nullptr, frame.zoom)) {
+            memset(PBUFFER->data, 0, PBUFFER->size);
+            frame.zoom = {};
+        }
+    } else if (!REPAINT.empty()) {
+        PBUFFER->surface = cairo_image_surface_create_for_data((unsigned char*)PBUFFER->data, HIGHPRECISION ? CAIRO_FORMAT_RGB30 : CAIRO_FORMAT_ARGB32, PBUFFER->pixelSize.x,
+                                                               PBUFFER->pixelSize.y, PBUFFER->pixelSize.x * 4);
+
+        PBUFFER->cairo = cairo_create(PBUFFER->surface);
+
+        const auto PCAIRO = PBUFFER->cairo;
+
+        for (const auto& box : REPAINT) {
+            cairo_rectangle(PCAIRO, box.x, box.y, box.w, box.h);
+        }
+        cairo_clip(PCAIRO);
+
+        // the frozen background only needs the preview, full resolution is reserved for the lenses
+        if (PREVIEW) {
+            const auto SCALEPREVIEW = IMAGE->previewSize() / PBUFFER->pixelSize;
+            const auto PATTERNPRE   = cairo_pattern_create_for_surface(IMAGE->previewSurface());
+            cairo_pattern_set_filter(PATTERNPRE, CAIRO_FILTER_BILINEAR);
+            cairo_matrix_t matrixPre;
+            cairo_matrix_init_identity(&matrixPre);
+            cairo_matrix_scale(&matrixPre, SCALEPREVIEW.x, SCALEPREVIEW.y);
+            cairo_pattern_set_matrix(PATTERNPRE, &matrixPre);
+            cairo_set_operator(PCAIRO, CAIRO_OPERATOR_SOURCE);
+            cairo_set_source(PCAIRO, PATTERNPRE);
+            cairo_paint(PCAIRO);
+            cairo_pattern_destroy(PATTERNPRE);
+        } else {
+            cairo_set_operator(PCAIRO, CAIRO_OPERATOR_SOURCE);
+            cairo_set_source_rgba(PCAIRO, 0, 0, 0, 0);
+            cairo_paint(PCAIRO);
+        }
 
         cairo_surface_flush(PBUFFER->surface);
-        cairo_pattern_destroy(PATTERNPRE);
+
+        // getDamage grew the damage over every lens it touches, so those are redrawn whole on a clean background
+        for (size_t i = 0; i < frame.lenses.size(); ++i) {
+            const auto& lens = frame.lenses[i];
+            const auto  BOX  = lensBox(lens, frame.size);
+            if (std::ranges::none_of(REPAINT, [&BOX](const auto& box) { return box.intersects(BOX); }))
+                continue;
+
+            drawLens(PBUFFER, sources[i], lens, HIGHPRECISION);
+            if (lens.cursor)
+                drawCursor(PBUFFER, lens, HIGHPRECISION);
+            if (lens.readout)
+                drawReadout(PBUFFER, IMAGE.get(), lens, HIGHPRECISION);
+        }
+
+        cairo_surface_mark_dirty(PBUFFER->surface);
+
+        cairo_destroy(PCAIRO);
+        cairo_surface_destroy(PBUFFER->surface);
+        PBUFFER->cairo   = nullptr;
+        PBUFFER->surface = nullptr;
     }
 
-    pSurface->sendFrame();
-    cairo_destroy(PCAIRO);
-    cairo_surface_destroy(PBUFFER->surface);
+    if (LENS && !HIDE && m_pStream)
+        m_pStream->writeFrame(PBUFFER.get(), m_vPosition.floor() * SCALE, m_vSize);
+
+    pSurface->sendFrame(PBUFFER, getDamage(pSurface->committed, frame));
+
+    if (LENS || frame.generation != pSurface->committed.generation)
+        scheduleNeighbours(pSurface);
+
+    pSurface->committed = frame;
+    PBUFFER->drawn      = std::move(frame);
+
+    if (HIDE)
+        pSurface->recapture = RECAPTURE_HIDDEN;
+
+    PBUFFER->busy = true;
+
+    if (!pSurface->rendered)
+        traceStartup("first commit", pSurface->m_pMonitor);
 
-    PBUFFER->busy    = true;
-    PBUFFER->cairo   = nullptr;
-    PBUFFER->surface = nullptr;
+    if (!pSurface->rendered && m_iActivationTime) {
+        Debug::log(LOG, "first frame on %s %.2fms after activation", pSurface->m_pMonitor->name.c_str(), (m_pLatencyTracker->now() - m_iActivationTime) / 1000000.0);
+        if (std::ranges::all_of(m_vLayerSurfaces, [pSurface](const auto& ls) { return ls.get() == pSurface || ls->rendered; }))
+            m_iActivationTime = 0;
+    }
 
     pSurface->rendered = true;
+    m_iFramesRendered++;
+
+    // the pointer output paces the governor, the other outputs only add their work to its frames
+    m_pGovernor->addRender(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - BEGIN).count());
+
+    const auto REFRESH = pSurface->m_pMonitor->refresh > 0 ? 1000000000000ULL / pSurface->m_pMonitor->refresh : 1000000000ULL / 60;
+    if (LENS && m_pGovernor->onFrame(REFRESH))
+        onQualityChanged();
+}
+
+// lens filters are drawn at the new quality right away, the capture rate and background refresh follow on their own
+void CHyprmagnifier::onQualityChanged() {
+    markDirty();
+}
+
+// the captures under what a lens magnifies, mapped onto the mask of its draw on pSurface
+std::vector<SLensSource> CHyprmagnifier::lensSources(CLayerSurface* pSurface, const SLayoutLens& lens, const SLensDraw& draw, const Vector2D& scale) {
+    const auto               BOX    = CLensMask::box(draw, m_dBorderWidth);
+    const auto               HALF   = lens.size / 2.0 * lens.zoom;
+    const auto               ORIGIN = pSurface->m_pMonitor->position + Vector2D{(double)BOX.x, (double)BOX.y} / scale; // of mask pixel 0, 0 in the layout
+
+    std::vector<SLensSource> sources;
+
+    for (const auto& ls : m_vLayerSurfaces) {
+        const auto& MON = *ls->m_pMonitor;
+
+        if (!ls->captured || !ls->image || lens.center.x + HALF.x <= MON.position.x || lens.center.x - HALF.x >= MON.position.x + MON.size.x ||
+            lens.center.y + HALF.y <= MON.position.y || lens.center.y - HALF.y >= MON.position.y + MON.size.y)
+            continue;
+
+        const auto IMAGESCALE = ls->image->size() / MON.size;
+
+        sources.push_back({.image  = ls->image.get(),
+                           .origin = (lens.center - MON.position + (ORIGIN - lens.center) * lens.zoom) * IMAGESCALE,
+                           .scale  = lens.zoom * IMAGESCALE.x / scale.x});
+    }
+
+    return sources;
+}
+
+// other outputs that show a lens sampling the captures of others, or that the live lens just reached, get a frame too.
+// Outputs no lens reaches across are left alone
+void CHyprmagnifier::scheduleNeighbours(CLayerSurface* pSurface) {
+    if (m_vLayerSurfaces.size() < 2)
+        return;
+
+    // under pressure they catch up in batches, the background timer comes back to refresh them all at once
+    if (m_pGovernor->level() >= QUALITY_BACKGROUND) {
+        if (!m_bBackgroundPending) {
+            m_bBackgroundPending = true;
+            m_pEventLoop->updateTimer(m_iBackgroundTimer, CQualityGovernor::BACKGROUND_INTERVAL_MS);
+        }
+        return;
+    }
+
+    refreshNeighbours(pSurface);
+}
+
+void CHyprmagnifier::refreshNeighbours(CLayerSurface* pSurface) {
+    const bool        HASLIVE = m_bActive && m_pLastSurface;
+    const SLayoutLens LIVE    = HASLIVE ? liveLens() : SLayoutLens{};
+
+    for (auto& ls : m_vLayerSurfaces) {
+        if (ls.get() == pSurface || ls->frameCallback || !ls->captured)
+            continue;
+
+        const auto& MON     = *ls->m_pMonitor;
+        bool        reached = std::ranges::any_of(ls->committed.lenses, [](const auto& lens) { return lens.live || lens.sources; });
+
+        if (!reached && HASLIVE) {
+            const auto HALF = LIVE.size / 2.0 + Vector2D{m_dBorderWidth, m_dBorderWidth};
+            reached         = LIVE.center.x + HALF.x > MON.position.x && LIVE.center.x - HALF.x < MON.position.x + MON.size.x && LIVE.center.y + HALF.y > MON.position.y &&
+                LIVE.center.y - HALF.y < MON.position.y + MON.size.y;
+        }
+
+        if (reached)
+            ls->markDirty();
+    }
+}
+
+// boxes that differ between two frames. Lenses that only overlap the damage are redrawn whole, so their boxes join it too
+std::vector<SDamageBox> CHyprmagnifier::getDamage(const SDrawnFrame& from, const SDrawnFrame& to) {
+    const auto& lenses = to.lenses;
+
+    // a new image under a frozen background or a full-screen zoom, or a different background altogether
+    if (!from.generation || from.size != to.size || from.preview != to.preview || from.zoom != to.zoom || ((to.preview || to.zoom.scale > 0) && from.generation != to.generation))
+        return {{.x = 0, .y = 0, .w = (int)to.size.x, .h = (int)to.size.y}};
+
+    // a transparent background stays, but every lens shows the new image
+    const bool              NEWIMAGE = from.generation != to.generation;
+
+    std::vector<SDamageBox> damage;
+    std::vector<bool>       damaged(lenses.size(), false);
+
+    for (const auto& drawn : from.lenses) {
+        if (NEWIMAGE || std::ranges::find(lenses, drawn) == lenses.end())
+            damage.push_back(lensBox(drawn, from.size));
+    }
+
+    for (size_t i = 0; i < lenses.size(); ++i) {
+        if (!NEWIMAGE && std::ranges::find(from.lenses, lenses[i]) != from.lenses.end())
+            continue;
+
+        damage.push_back(lensBox(lenses[i], to.size));
+        damaged[i] = true;
+    }
+
+    // a handful of lenses at most, so this settles in a pass or two
+    for (bool grew = !damage.empty(); grew;) {
+        grew = false;
+        for (size_t i = 0; i < lenses.size(); ++i) {
+            const auto BOX = lensBox(lenses[i], to.size);
+            if (damaged[i] || std::ranges::none_of(damage, [&BOX](const auto& box) { return box.intersects(BOX); }))
+                continue;
+
+            damage.push_back(BOX);
+            damaged[i] = true;
+            grew       = true;
+        }
+    }
+
+    // clipped to the buffer for wl_surface.damage_buffer
+    for (auto& box : damage) {
+        const int X1 = std::min(box.x + box.w, (int)to.size.x), Y1 = std::min(box.y + box.h, (int)to.size.y);
+        box.x        = std::max(box.x, 0);
+        box.y        = std::max(box.y, 0);
+        box.w        = std::max(X1 - box.x, 0);
+        box.h        = std::max(Y1 - box.y, 0);
+    }
+
+    std::erase_if(damage, [](const auto& box) { return !box.w || !box.h; });
+
+    return damage;
+}
+
+CLensMask* CHyprmagnifier::getLensMask(const Vector2D& size, eLensShape shape) {
+    for (auto& mask : m_vLensMasks) {
+        if (mask->matches(size, shape))
+            return mask.get();
+    }
+
+    // sizes only change on request, the oldest mask is the least likely to come back
+    if (m_vLensMasks.size() >= LENS_MASKS)
+        m_vLensMasks.erase(m_vLensMasks.begin());
+
+    return m_vLensMasks.emplace_back(std::make_unique<CLensMask>(size, shape, m_dLensRadius, m_dBorderWidth, m_cBorderColor)).get();
+}
+
+// pixels drawn for a lens, its readout included
+SDamageBox CHyprmagnifier::lensBox(const SLensDraw& lens, const Vector2D& bufferSize) {
+    const auto BOX = CLensMask::box(lens, m_dBorderWidth);
+
+    if (!lens.readout)
+        return BOX;
+
+    const auto READOUT = readoutBox(lens, bufferSize);
+    const int  X0 = std::min(BOX.x, READOUT.x), Y0 = std::min(BOX.y, READOUT.y);
+
+    return {.x = X0, .y = Y0, .w = std::max(BOX.x + BOX.w, READOUT.x + READOUT.w) - X0, .h = std::max(BOX.y + BOX.h, READOUT.y + READOUT.h) - Y0};
+}
+
+// the readout panel sits centered under the lens, or above it when it would leave the buffer
+SDamageBox CHyprmagnifier::readoutBox(const SLensDraw& lens, const Vector2D& bufferSize) {
+    const auto ATLAS = getGlyphAtlas(lens.readout);
+    const auto BOX   = CLensMask::box(lens, m_dBorderWidth);
+    const int  PAD   = ATLAS->cellWidth() / 2;
+    const int  W     = READOUT_COLUMNS * ATLAS->cellWidth() + 2 * PAD;
+    const int  H     = READOUT_LINES * ATLAS->cellHeight() + 2 * PAD;
+    const int  X     = std::clamp(BOX.x + (BOX.w - W) / 2, 0, std::max((int)bufferSize.x - W, 0));
+    const int  Y     = BOX.y + BOX.h + PAD + H <= bufferSize.y ? BOX.y + BOX.h + PAD : BOX.y - PAD - H;
+
+    return {.x = X, .y = Y, .w = W, .h = H};
+}
+
+CGlyphAtlas* CHyprmagnifier::getGlyphAtlas(int pixelHeight) {
+    for (auto& atlas : m_vGlyphAtlases) {
+        if (atlas->pixelHeight() == pixelHeight)
+            return atlas.get();
+    }
+
+    return m_vGlyphAtlases.emplace_back(std::make_unique<CGlyphAtlas>(pixelHeight)).get();
+}
+
+// the pointer sprite over a lens, clipped to its solid part so the edge and the border stay as they are
+void CHyprmagnifier::drawCursor(SP<SPoolBuffer> pBuffer, const SLensDraw& lens, bool highPrecision) {
+    if (!m_pCursorSprite)
+        m_pCursorSprite = std::make_unique<CCursorSprite>();
+
+    const auto& SPRITE = m_pCursorSprite->scaled(lens.cursor);
+    const auto& MASK   = *getLensMask(lens.size, lens.shape);
+    const auto  BOX    = CLensMask::box(lens, m_dBorderWidth);
+    const int   WIDTH  = pBuffer->pixelSize.x;
+    const int   HEIGHT = pBuffer->pixelSize.y;
+
+    // top left of the sprite in mask pixels
+    const int SX = std::round(lens.hotspot.x - SPRITE.hotspot.x) - BOX.x;
+    const int SY = std::round(lens.hotspot.y - SPRITE.hotspot.y) - BOX.y;
+
+    const int Y0 = std::max({SY, 0, -BOX.y});
+    const int Y1 = std::min({SY + SPRITE.height, MASK.height(), HEIGHT - BOX.y});
+
+    for (int y = Y0; y < Y1; ++y) {
+        const auto& ROW   = MASK.row(y);
+        const int   BEGIN = std::max({ROW.solidBegin, SX, -BOX.x});
+        const int   END   = std::min({ROW.solidEnd, SX + SPRITE.width, WIDTH - BOX.x});
+
+        if (BEGIN >= END)
+            continue;
+
+        CCursorSprite::blend((uint32_t*)pBuffer->data + (size_t)(BOX.y + y) * WIDTH + (BOX.x + BEGIN), SPRITE.pixels.data() + (size_t)(y - SY) * SPRITE.width + (BEGIN - SX),
+                             END - BEGIN, highPrecision);
+    }
+}
+
+// the center pixel of the lens and statistics over the image rect it magnifies, for a circle its bounding rect
+void CHyprmagnifier::drawReadout(SP<SPoolBuffer> pBuffer, CCaptureImage* pImage, const SLensDraw& lens, bool highPrecision) {
+    const auto ATLAS  = getGlyphAtlas(lens.readout);
+    const auto BOX    = readoutBox(lens, pBuffer->pixelSize);
+    const auto CENTER = lens.center / pBuffer->pixelSize * pImage->size();
+    const auto SOURCE = lens.size * lens.zoom;
+    const auto ORIGIN = (CENTER - SOURCE / 2.0).round();
+    const auto PIXEL  = pImage->pixel(std::floor(CENTER.x), std::floor(CENTER.y));
+    // a zoomed out lens covers a lot of the image, its statistics come from the mip level it is sampled from
+    const auto STATS  = pImage->regionStats(ORIGIN.x, ORIGIN.y, std::max(std::round(SOURCE.x), 1.0), std::max(std::round(SOURCE.y), 1.0), pImage->levelFor(lens.zoom));
+    const bool DEEP   = pImage->highPrecision();
+
+    // r, g, b of the center in the depth of the image, the hex code is always 8 bits
+    const int R     = DEEP ? (PIXEL >> 20) & 0x3FF : (PIXEL >> 16) & 0xFF;
+    const int G     = DEEP ? (PIXEL >> 10) & 0x3FF : (PIXEL >> 8) & 0xFF;
+    const int B     = DEEP ? PIXEL & 0x3FF : PIXEL & 0xFF;
+    const int SHIFT = DEEP ? 2 : 0;
+
+    const std::string LINES[READOUT_LINES] = {
+        m_bUseLowerCase ? std::format("#{:02x}{:02x}{:02x}", R >> SHIFT, G >> SHIFT, B >> SHIFT) : std::format("#{:02X}{:02X}{:02X}", R >> SHIFT, G >> SHIFT, B >> SHIFT),
+        std::format("rgb{:5}{:5}{:5}", R, G, B),
+        std::format("avg{:5.0f}{:5.0f}{:5.0f}", STATS.mean(0), STATS.mean(1), STATS.mean(2)),
+        std::format("min{:5}{:5}{:5}", STATS.min[0], STATS.min[1], STATS.min[2]),
+        std::format("max{:5}{:5}{:5}", STATS.max[0], STATS.max[1], STATS.max[2]),
+    };
+
+    const int  WIDTH  = pBuffer->pixelSize.x;
+    const int  HEIGHT = pBuffer->pixelSize.y;
+    const int  PAD    = ATLAS->cellWidth() / 2;
+    const auto DATA   = (uint32_t*)pBuffer->data;
+
+    ATLAS->shade(DATA, WIDTH, HEIGHT, BOX.x, BOX.y, BOX.w, BOX.h, {.r = 0, .g = 0, .b = 0, .a = 200}, highPrecision);
+
+    // a swatch of the center pixel fills the rest of the first line
+    const CColor SWATCH = {.r = (uint8_t)(R >> SHIFT), .g = (uint8_t)(G >> SHIFT), .b = (uint8_t)(B >> SHIFT), .a = 255};
+    ATLAS->shade(DATA, WIDTH, HEIGHT, BOX.x + PAD + 8 * ATLAS->cellWidth(), BOX.y + PAD, (READOUT_COLUMNS - 8) * ATLAS->cellWidth(), ATLAS->cellHeight(), SWATCH,
+                 highPrecision);
+
+    for (int i = 0; i < READOUT_LINES; ++i) {
+        ATLAS->draw(DATA, WIDTH, HEIGHT, BOX.x + PAD, BOX.y + PAD + i * ATLAS->cellHeight(), LINES[i], {.r = 230, .g = 230, .b = 230, .a = 255}, highPrecision);
+    }
+}
+
+// draws a lens into a buffer covering the whole output. Solid lens pixels of a single capture are sampled straight into
+// the buffer, only the anti-aliased edge and the border go through the mask blend
+void CHyprmagnifier::drawLens(SP<SPoolBuffer> pBuffer, std::span<const SLensSource> sources, const SLensDraw& lens, bool highPrecision) {
+    const auto& MASK   = *getLensMask(lens.size, lens.shape);
+    const auto  BOX    = CLensMask::box(lens, m_dBorderWidth);
+    const int   WIDTH  = pBuffer->pixelSize.x;
+    const int   HEIGHT = pBuffer->pixelSize.y;
+    const int   OX     = BOX.x;
+    const int   OY     = BOX.y;
+
+    const int Y0 = std::max(0, -OY);
+    const int Y1 = std::min(MASK.height(), HEIGHT - OY);
+    const int X0 = std::max(0, -OX);
+    const int X1 = std::min(MASK.width(), WIDTH - OX);
+
+    if (X0 >= X1 || Y0 >= Y1)
+        return;
+
+    // a filter sees the whole visible lens box at once (sharpen reads the rows around each pixel), and a lens across
+    // outputs is put together from several captures, so both are sampled into a scratch block that the rows are then
+    // copied and blended from
+    if (lens.filter || sources.size() != 1 || (highPrecision && !sources[0].image->highPrecision())) {
+        const int W = X1 - X0;
+        const int H = Y1 - Y0;
+
+        // whatever no capture covers stays black
+        m_vLensScratch.assign((size_t)W * H, highPrecision ? 0xC0000000 : 0xFF000000);
+
+        for (const auto& source : sources) {
+            // the part of the mask this capture covers, in the same rounding the samplers use
+            const auto SIZE = source.image->size();
+            const int  SX0  = std::clamp((int)std::ceil(-source.origin.x / source.scale - 0.5), X0, X1);
+            const int  SX1  = std::clamp((int)std::ceil((SIZE.x - source.origin.x) / source.scale - 0.5), SX0, X1);
+            const int  SY0  = std::clamp((int)std::ceil(-source.origin.y / source.scale - 0.5), Y0, Y1);
+            const int  SY1  = std::clamp((int)std::ceil((SIZE.y - source.origin.y) / source.scale - 0.5), SY0, Y1);
+
+            if (SX0 >= SX1 || SY0 >= SY1)
+                continue;
+
+            uint32_t* block = m_vLensScratch.data() + (size_t)(SY0 - Y0) * W + (SX0 - X0);
+            source.image->sample(block, W * sizeof(uint32_t), SX0, SY0, SX1 - SX0, SY1 - SY0, source.origin, source.scale);
+
+            // outputs can be captured in different depths, each part is brought to the depth of the buffer where it landed
+            if (source.image->highPrecision() == highPrecision)
+                continue;
+
+            const auto CONVERT = highPrecision ? Formats::info(WL_SHM_FORMAT_ARGB8888)->to10Bit : Formats::info(WL_SHM_FORMAT_XRGB2101010)->to8Bit;
+            for (int y = 0; y < SY1 - SY0; ++y) {
+                CONVERT((const uint8_t*)(block + (size_t)y * W), 4, block + (size_t)y * W, SX1 - SX0);
+            }
+        }
+
+        if (lens.filter)
+            lens.filter->apply(m_vLensScratch.data(), W, W, H, highPrecision, lens.reduced);
+
+        for (int y = Y0; y < Y1; ++y) {
+            const auto& ROW   = MASK.row(y);
+            const int   BEGIN = std::max(ROW.begin, X0);
+            const int   END   = std::min(ROW.end, X1);
+
+            if (BEGIN >= END)
+                continue;
+
+            const int       SOLIDBEGIN = std::clamp(ROW.solidBegin, BEGIN, END);
+            const int       SOLIDEND   = std::clamp(ROW.solidEnd, SOLIDBEGIN, END);
+            uint32_t*       row        = (uint32_t*)pBuffer->data + (size_t)(OY + y) * WIDTH;
+            const uint32_t* lensRow    = m_vLensScratch.data() + (size_t)(y - Y0) * W;
+
+            memcpy(row + (OX + SOLIDBEGIN), lensRow + (SOLIDBEGIN - X0), (SOLIDEND - SOLIDBEGIN) * sizeof(uint32_t));
+            MASK.blend(row + (OX + BEGIN), lensRow + (BEGIN - X0), BEGIN, y, SOLIDBEGIN - BEGIN, highPrecision);
+            MASK.blend(row + (OX + SOLIDEND), lensRow + (SOLIDEND - X0), SOLIDEND, y, END - SOLIDEND, highPrecision);
+        }
+        return;
+    }
+
+    const auto& SOURCE = sources[0];
+    const auto  IMAGE  = SOURCE.image;
+
+    // a 10-bit image under a transparent 8-bit frame, every lens pixel goes through the scratch row and gets narrowed
+    const auto NARROW = IMAGE->highPrecision() && !highPrecision ? Formats::info(WL_SHM_FORMAT_XRGB2101010)->to8Bit : nullptr;
+
+    m_vLensRow.resize(MASK.width());
+
+    for (int y = Y0; y < Y1; ++y) {
+        const auto& ROW   = MASK.row(y);
+        const int   BEGIN = std::max(ROW.begin, -OX);
+        const int   END   = std::min(ROW.end, WIDTH - OX);
+
+        if (BEGIN >= END)
+            continue;
+
+        const int SOLIDBEGIN = std::clamp(ROW.solidBegin, BEGIN, END);
+        const int SOLIDEND   = std::clamp(ROW.solidEnd, SOLIDBEGIN, END);
+        uint32_t* row        = (uint32_t*)pBuffer->data + (size_t)(OY + y) * WIDTH;
+
+        if (NARROW) {
+            IMAGE->sample(m_vLensRow.data(), 0, BEGIN, y, END - BEGIN, 1, SOURCE.origin, SOURCE.scale);
+            NARROW((const uint8_t*)m_vLensRow.data(), 4, m_vLensRow.data(), END - BEGIN);
+
+            memcpy(row + (OX + SOLIDBEGIN), m_vLensRow.data() + (SOLIDBEGIN - BEGIN), (SOLIDEND - SOLIDBEGIN) * sizeof(uint32_t));
+            MASK.blend(row + (OX + BEGIN), m_vLensRow.data(), BEGIN, y, SOLIDBEGIN - BEGIN, false);
+            MASK.blend(row + (OX + SOLIDEND), m_vLensRow.data() + (SOLIDEND - BEGIN), SOLIDEND, y, END - SOLIDEND, false);
+            continue;
+        }
+
+        if (SOLIDBEGIN < SOLIDEND)
+            IMAGE->sample(row + (OX + SOLIDBEGIN), 0, SOLIDBEGIN, y, SOLIDEND - SOLIDBEGIN, 1, SOURCE.origin, SOURCE.scale);
+
+        for (const auto& [FROM, TO] : {std::pair{BEGIN, SOLIDBEGIN}, std::pair{SOLIDEND, END}}) {
+            if (FROM >= TO)
+                continue;
+
+            IMAGE->sample(m_vLensRow.data(), 0, FROM, y, TO - FROM, 1, SOURCE.origin, SOURCE.scale);
+            MASK.blend(row + (OX + FROM), m_vLensRow.data(), FROM, y, TO - FROM, highPrecision);
+        }
+    }
 }
 
 
@@ -472,15 +1277,94 @@ void CHyprmagnifier::initKeyboard() {
         }
     });
 
+    m_pKeyboard->setRepeatInfo([this](CCWlKeyboard* r, int32_t rate, int32_t delay) {
+        m_iRepeatRate  = rate;
+        m_iRepeatDelay = delay;
+    });
+
+    m_pKeyboard->setLeave([this](CCWlKeyboard* r, uint32_t serial, wl_proxy* surface) {
+        m_iRepeatKey = 0;
+        m_pEventLoop->updateTimer(m_iRepeatTimer, 0);
+    });
+
     m_pKeyboard->setKey([this](CCWlKeyboard* r, uint32_t serial, uint32_t time, uint32_t key, uint32_t state) {
-        if (state != WL_KEYBOARD_KEY_STATE_PRESSED)
+        if (state != WL_KEYBOARD_KEY_STATE_PRESSED) {
+            if (key == m_iRepeatKey) {
+                m_iRepeatKey = 0;
+                m_pEventLoop->updateTimer(m_iRepeatTimer, 0);
+            }
+            return;
+        }
+
+        xkb_keysym_t sym = XKB_KEY_NoSymbol;
+        if (m_pXKBState)
+            sym = xkb_state_key_get_one_sym(m_pXKBState, key + 8);
+        else if (key == 1) // Assume keycode 1 is escape
+            sym = XKB_KEY_Escape;
+
+        if (sym == XKB_KEY_Escape) {
+            if (m_bDaemon)
+                deactivate();
+            else
+                m_pEventLoop->stop();
+            return;
+        }
+
+        if (sym == XKB_KEY_p) {
+            pinLens();
+            return;
+        }
+
+        if (sym == XKB_KEY_BackSpace) {
+            unpinLens();
             return;
+        }
+
+        if (sym == XKB_KEY_f) {
+            cycleFilter();
+            return;
+        }
+
+        if (sym == XKB_KEY_s || sym == XKB_KEY_S) {
+            snapshot(sym == XKB_KEY_S);
+            return;
+        }
+
+        if (sym == XKB_KEY_r) {
+            recapture();
+            return;
+        }
+
+        if (sym == XKB_KEY_c) {
+            m_bDisableHexPreview = !m_bDisableHexPreview;
+            markDirty();
+            return;
+        }
 
-        if (m_pXKBState) {
-            if (xkb_state_key_get_one_sym(m_pXKBState, key + 8) == XKB_KEY_Escape)
-                finish(0);
-        } else if (key == 1) // Assume keycode 1 is escape
-            finish(0);
+        if (sym == XKB_KEY_z) {
+            m_bFullscreen = !m_bFullscreen;
+            markDirty();
+            return;
+        }
+
+        // same units as a scroll axis, one step per press or repeat
+        double step = 0.0;
+        if (sym == XKB_KEY_plus || sym == XKB_KEY_equal || sym == XKB_KEY_KP_Add)
+            step = -10.0;
+        else if (sym == XKB_KEY_minus || sym == XKB_KEY_KP_Subtract)
+            step = 10.0;
+
+        if (step == 0.0)
+            return;
+
+        onZoomKey(step);
+
+        if (m_iRepeatRate <= 0 || !xkb_keymap_key_repeats(m_pXKBKeymap, key + 8))
+            return;
+
+        m_iRepeatKey  = key;
+        m_dRepeatStep = step;
+        m_pEventLoop->updateTimer(m_iRepeatTimer, m_iRepeatDelay, std::max(1000 / m_iRepeatRate, 1));
     });
 }
 
@@ -489,8 +1373,11 @@ void CHyprmagnifier::initMouse() {
         auto x = wl_fixed_to_double(surface_x);
         auto y = wl_fixed_to_double(surface_y);
 
-        m_vLastCoords = {x, y};
-        m_vPosition = {x, y};
+        m_vLastCoords    = {x, y};
+        m_vPendingCoords = {x, y};
+        m_vPosition      = {x, y};
+        m_bPendingMotion = false;
+        m_dqPointerSamples.clear();
 
         for (auto& ls : m_vLayerSurfaces) {
             if (ls->pSurface->resource() == surface) {
@@ -501,6 +1388,7 @@ void CHyprmagnifier::initMouse() {
 
         m_pCursorShapeDevice->sendSetShape(serial, WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_CROSSHAIR);
 
+        markInput();
         markDirty();
     });
     m_pPointer->setLeave([this](CCWlPointer* r, uint32_t timeMs, wl_proxy* surface) {
@@ -514,34 +1402,80 @@ void CHyprmagnifier::initMouse() {
 
         markDirty();
     });
+    // motion and axis only record the newest state, latchInput() applies it once per frame
     m_pPointer->setMotion([this](CCWlPointer* r, uint32_t timeMs, wl_fixed_t surface_x, wl_fixed_t surface_y) {
-        auto x = wl_fixed_to_double(surface_x);
-        auto y = wl_fixed_to_double(surface_y);
+        m_vPendingCoords = {wl_fixed_to_double(surface_x), wl_fixed_to_double(surface_y)};
+        m_bPendingMotion = true;
 
-        Vector2D currentPos = {x, y};
-
-        if (m_eMoveType == MOVE_CORNER) {
-            if (
-                x >= m_vPosition.x + (m_vSize.x / 2.0) ||
-                x <= m_vPosition.x - (m_vSize.x / 2.0) ||
-                y >= m_vPosition.y + (m_vSize.y / 2.0) ||
-                y <= m_vPosition.y - (m_vSize.y / 2.0)
-            ) {
-                m_vPosition += currentPos - m_vLastCoords;
-                markDirty();
-            }
-        } else if (m_eMoveType == MOVE_CURSOR) {
-            m_vPosition = currentPos;
-        }
+        m_dqPointerSamples.push_back({timeMs, m_vPendingCoords});
+        while (m_dqPointerSamples.size() > POINTER_SAMPLES)
+            m_dqPointerSamples.pop_front();
 
-        m_vLastCoords = currentPos;
+        markInput();
+        scheduleFrame();
     });
-    m_pPointer->setAxis([this](CCWlPointer *, uint32_t timeMs, enum wl_pointer_axis axis, wl_fixed_t value) {
-        double v = wl_fixed_to_double(value);
-
-        double factor = std::pow(0.5f, -v / 50.0);
-        m_dZoom = std::clamp(m_dZoom * factor, 0.01, 1.0);
+    m_pPointer->setAxis([this](CCWlPointer*, uint32_t timeMs, enum wl_pointer_axis axis, wl_fixed_t value) {
+        m_dPendingAxis += wl_fixed_to_double(value);
 
-        markDirty();
+        markInput();
+        scheduleFrame();
     });
 }
+
+void CHyprmagnifier::scheduleFrame() {
+    if (!m_pLastSurface || m_pLastSurface->frameCallback)
+        return;
+
+    m_pLastSurface->markDirty();
+}
+
+void CHyprmagnifier::latchInput() {
+    if (m_dPendingAxis != 0.0) {
+        const double FACTOR = std::pow(0.5, -m_dPendingAxis / 50.0);
+        m_dZoom             = std::clamp(m_dZoom * FACTOR, 0.01, MAX_ZOOM);
+        m_dPendingAxis      = 0.0;
+    }
+
+    if (!m_bPendingMotion)
+        return;
+
+    m_bPendingMotion = false;
+
+    const auto CURRENTPOS = m_vPendingCoords;
+
+    if (m_eMoveType == MOVE_CORNER) {
+        if (CURRENTPOS.x >= m_vPosition.x + (m_vSize.x / 2.0) || CURRENTPOS.x <= m_vPosition.x - (m_vSize.x / 2.0) || CURRENTPOS.y >= m_vPosition.y + (m_vSize.y / 2.0) ||
+            CURRENTPOS.y <= m_vPosition.y - (m_vSize.y / 2.0))
+            m_vPosition += CURRENTPOS - m_vLastCoords;
+    } else if (m_eMoveType == MOVE_CURSOR)
+        m_vPosition = m_bPredictMotion ? predictPosition() : CURRENTPOS;
+
+    m_vLastCoords = CURRENTPOS;
+}
+
+// extrapolates the newest pointer sample by its recent velocity, one refresh interval ahead
+Vector2D CHyprmagnifier::predictPosition() {
+    if (m_dqPointerSamples.size() < 2 || !m_pLastSurface)
+        return m_vPendingCoords;
+
+    const auto& NEWEST = m_dqPointerSamples.back();
+    const auto* oldest = &m_dqPointerSamples.front();
+
+    // only trust samples from the last 50ms, older ones describe a different gesture
+    for (const auto& s : m_dqPointerSamples) {
+        if (NEWEST.timeMs - s.timeMs <= 50) {
+            oldest = &s;
+            break;
+        }
+    }
+
+    const auto DT = NEWEST.timeMs - oldest->timeMs;
+    if (DT == 0)
+        return m_vPendingCoords;
+
+    const auto   VELOCITY  = (NEWEST.pos - oldest->pos) / (double)DT;
+    const double REFRESH   = m_pLatencyTracker->m_iRefreshNs ? m_pLatencyTracker->m_iRefreshNs / 1000000.0 : 1000.0 / 60.0;
+    const auto   PREDICTED = NEWEST.pos + VELOCITY * REFRESH;
+
+    return {std::clamp(PREDICTED.x, 0.0, m_pLastSurface->m_pMonitor->size.x), std::clamp(PREDICTED.y, 0.0, m_pLastSurface->m_pMonitor->size.y)};
+}
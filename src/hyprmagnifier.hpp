@@ -3,6 +3,40 @@
 #include "defines.hpp"
 #include "helpers/LayerSurface.hpp"
 #include "helpers/PoolBuffer.hpp"
+#include "helpers/Latency.hpp"
+#include "helpers/IPC.hpp"
+#include "helpers/EventLoop.hpp"
+#include "helpers/MemoryTracker.hpp"
+#include "helpers/LensMask.hpp"
+#include "helpers/ColorFilter.hpp"
+#include "helpers/GlyphAtlas.hpp"
+#include "helpers/Snapshot.hpp"
+#include "helpers/LensStream.hpp"
+#include "helpers/Governor.hpp"
+#include "helpers/Udmabuf.hpp"
+#include "helpers/CursorSprite.hpp"
+#include "helpers/FullscreenZoom.hpp"
+
+struct SPointerSample {
+    uint32_t timeMs = 0;
+    Vector2D pos;
+};
+
+// a lens in the global layout of outputs, in logical pixels. Pinned lenses keep the state the live lens had when they
+// were pinned, so either can be drawn on every output it reaches
+struct SLayoutLens {
+    Vector2D                      center;
+    Vector2D                      size;
+    double                        zoom = 0.5; // logical pixels magnified per logical pixel of the lens
+    std::shared_ptr<CColorFilter> filter;
+};
+
+// a capture a lens samples, origin is the image position of mask pixel 0, 0 and scale the image pixels per buffer pixel
+struct SLensSource {
+    CCaptureImage* image = nullptr;
+    Vector2D       origin;
+    double         scale = 1.0;
+};
 
 enum eMoveType {
     MOVE_CORNER = 0,
@@ -27,6 +61,10 @@ class CHyprmagnifier {
     SP<CCWlPointer>                             m_pPointer;
     SP<CCWpFractionalScaleManagerV1>            m_pFractionalMgr;
     SP<CCWpViewporter>                          m_pViewporter;
+    SP<CCWpPresentation>                        m_pPresentation;
+    SP<CCZxdgOutputManagerV1>                   m_pXDGOutputMgr;
+    SP<CCZwpLinuxDmabufV1>                      m_pLinuxDmabuf;
+    uint32_t                                    m_iScreencopyVersion = 1;
     wl_display*                                 m_pWLDisplay = nullptr;
     SP<CCWlSurface>                             m_pWLSurface;
 
@@ -36,12 +74,53 @@ class CHyprmagnifier {
 
     bool                                        m_bRenderInactive    = false;
     bool                                        m_bNoFractional      = false;
-    bool                                        m_bDisableHexPreview = true;
+    bool                                        m_bDisableHexPreview = false;
     bool                                        m_bUseLowerCase      = false;
-
-    double                                      m_dZoom = 0.5;
-
-    bool                                        m_bRunning = true;
+    bool                                        m_bTrackLatency      = false;
+    bool                                        m_bStartupTrace      = false;
+    bool                                        m_bMemoryStats       = false;
+    bool                                        m_bNo10Bit           = false;
+    bool                                        m_bSHM2101010        = false;
+    bool                                        m_bNoDmabuf          = false;
+    bool                                        m_bNoLensCursor      = false;
+    bool                                        m_bFullscreen        = false; // magnify the whole output instead of a lens
+
+    std::string                                 m_szLatencyHistogram = "";
+    std::unique_ptr<CLatencyTracker>            m_pLatencyTracker;
+    std::unique_ptr<CMemoryTracker>             m_pMemoryTracker = std::make_unique<CMemoryTracker>();
+    std::unique_ptr<CQualityGovernor>           m_pGovernor      = std::make_unique<CQualityGovernor>();
+    std::unique_ptr<CUdmabuf>                   m_pUdmabuf; // nullptr while captures go through shm
+    std::unique_ptr<CIPCServer>                 m_pIPC;
+    std::unique_ptr<CEventLoop>                 m_pEventLoop;
+    std::unique_ptr<CSnapshotWriter>            m_pSnapshots = std::make_unique<CSnapshotWriter>();
+    std::string                                 m_szSnapshotFormat = "png"; // extension of snapshots without a path
+    std::unique_ptr<CLensStream>                m_pStream;
+    std::string                                 m_szStreamPath   = "";
+    std::string                                 m_szStreamFormat = ""; // raw or y4m, empty to go by the extension
+    uint64_t                                    m_iFramesRendered   = 0;
+    uint64_t                                    m_iPendingInputTime = 0; // presentation-clock time of the oldest input not yet rendered, 0 if none
+
+    double                                      m_dZoom  = 0.5; // capture pixels per lens pixel
+    static constexpr double                     MAX_ZOOM = 8.0; // above 1 the lens shows a minified overview
+
+    bool                                        m_bDaemon         = false;
+    int                                         m_iPidFD          = -1; // the pid file, locked for as long as this is the daemon
+    bool                                        m_bActive         = true;
+    uint64_t                                    m_iActivationTime = 0;
+    std::chrono::steady_clock::time_point       m_tStartup;
+
+    uint64_t                                    m_iIdleTimeoutMs     = 0;  // 0 disables
+    uint32_t                                    m_iLiveHz            = 0;  // 0 keeps the frozen capture
+    int                                         m_iIdleTimer         = -1;
+    int                                         m_iLiveTimer         = -1;
+    int                                         m_iBackgroundTimer   = -1;
+    bool                                        m_bBackgroundPending = false;
+    uint64_t                                    m_iLiveTicks         = 0;
+    int                                         m_iRepeatTimer       = -1;
+    int32_t                                     m_iRepeatRate        = 25; // keys per second, 0 disables repeat
+    int32_t                                     m_iRepeatDelay       = 600;
+    uint32_t                                    m_iRepeatKey         = 0;
+    double                                      m_dRepeatStep        = 0.0;
 
     eMoveType                                   m_eMoveType = MOVE_CURSOR;
 
@@ -51,10 +130,53 @@ class CHyprmagnifier {
     CLayerSurface*                              m_pLastSurface;
 
     Vector2D                                    m_vLastCoords;
+    Vector2D                                    m_vPendingCoords;
+    bool                                        m_bPendingMotion = false;
+    double                                      m_dPendingAxis   = 0.0;
+    bool                                        m_bPredictMotion = false;
+    std::deque<SPointerSample>                  m_dqPointerSamples;
+    static constexpr size_t                     POINTER_SAMPLES = 8;
     Vector2D                                    m_vPosition;
     Vector2D                                    m_vSize = Vector2D(300, 150);
 
+    eLensShape                                  m_eLensShape   = LENS_RECT;
+    double                                      m_dLensRadius  = 16.0; // corner radius of LENS_ROUNDED
+    double                                      m_dBorderWidth = 2.0;
+    CColor                                      m_cBorderColor = {.r = 150, .g = 150, .b = 150, .a = 255};
+    std::vector<std::unique_ptr<CLensMask>>     m_vLensMasks;
+    static constexpr size_t                     LENS_MASKS = 8;
+    std::vector<uint32_t>                       m_vLensRow;     // lens pixels of the blended part of a mask row
+    std::vector<uint32_t>                       m_vLensScratch; // the whole lens box, for a filter or a lens across outputs
+    std::shared_ptr<CColorFilter>               m_pFilter;      // of the live lens, nullptr for none
+    std::vector<SLayoutLens>                    m_vPinnedLenses;
+    std::vector<std::unique_ptr<CGlyphAtlas>>   m_vGlyphAtlases; // one per readout size in use
+    std::unique_ptr<CCursorSprite>              m_pCursorSprite; // loaded with the first lens that shows the pointer
+    std::unique_ptr<CFullscreenZoom>            m_pFullscreenZoom; // and its workers with the first full-screen frame
+    static constexpr int                        READOUT_FONT    = 13; // logical pixels
+    static constexpr int                        READOUT_COLUMNS = 18;
+    static constexpr int                        READOUT_LINES   = 5;
+
     void                                        renderSurface(CLayerSurface*, bool forceInactive = false);
+    void                                        drawLens(SP<SPoolBuffer> pBuffer, std::span<const SLensSource> sources, const SLensDraw& lens, bool highPrecision);
+    SLayoutLens                                 liveLens();
+    std::vector<SLensSource>                    lensSources(CLayerSurface* pSurface, const SLayoutLens& lens, const SLensDraw& draw, const Vector2D& scale);
+    void                                        scheduleNeighbours(CLayerSurface* pSurface);
+    void                                        refreshNeighbours(CLayerSurface* pSurface);
+    void                                        onQualityChanged();
+    static Vector2D                             bufferScale(CLayerSurface* pSurface);
+    std::vector<SDamageBox>                     getDamage(const SDrawnFrame& from, const SDrawnFrame& to);
+    CLensMask*                                  getLensMask(const Vector2D& size, eLensShape shape);
+    SDamageBox                                  lensBox(const SLensDraw& lens, const Vector2D& bufferSize);
+    SDamageBox                                  readoutBox(const SLensDraw& lens, const Vector2D& bufferSize);
+    void                                        drawReadout(SP<SPoolBuffer> pBuffer, CCaptureImage* pImage, const SLensDraw& lens, bool highPrecision);
+    CGlyphAtlas*                                getGlyphAtlas(int pixelHeight);
+    void                                        drawCursor(SP<SPoolBuffer> pBuffer, const SLensDraw& lens, bool highPrecision);
+    bool                                        pinLens();
+    bool                                        unpinLens(bool all = false);
+    bool                                        recapture();
+    void                                        setFilter(const std::string& spec);
+    void                                        cycleFilter();
+    std::string                                 snapshot(bool full, const std::string& path = "");
 
     int                                         createPoolFile(size_t, std::string&);
     bool                                        setCloexec(const int&);
@@ -62,16 +184,34 @@ class CHyprmagnifier {
     void                                        initKeyboard();
     void                                        initMouse();
 
-    SP<SPoolBuffer>                             getBufferForLS(CLayerSurface*);
-
-    void                                        convertBuffer(SP<SPoolBuffer>);
-    void*                                       convert24To32Buffer(SP<SPoolBuffer>);
+    SP<SPoolBuffer>                             getBufferForLS(CLayerSurface*, bool highPrecision = false);
+    bool                                        use10Bit() const;
+    void                                        disableDmabuf(const char* reason);
 
     void                                        markDirty();
+    void                                        markInput();
+    void                                        scheduleFrame();
+    void                                        latchInput();
+    Vector2D                                    predictPosition();
+
+    void                                        printExitSummary();
+    void                                        printMemoryStats();
+    void                                        traceStartup(const char* event, const SMonitor* pMonitor = nullptr);
+
+    void                                        initTimers();
+    void                                        onZoomKey(double step);
+    void                                        onIdle();
+    void                                        onLiveTick();
+    std::string                                 getStats();
+    void                                        activate();
+    void                                        deactivate();
+    bool                                        writePidFile();
+    static std::string                          getRuntimePath(const char* name);
 
     void                                        finish(int code = 0);
 
   private:
+    void teardown();
 };
 
 inline std::unique_ptr<CHyprmagnifier> g_pHyprmagnifier;
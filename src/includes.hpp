@@ -12,9 +12,12 @@
 
 #include <protocols/cursor-shape-v1.hpp>
 #include <protocols/fractional-scale-v1.hpp>
+#include <protocols/linux-dmabuf-v1.hpp>
+#include <protocols/presentation-time.hpp>
 #include <protocols/wlr-layer-shell-unstable-v1.hpp>
 #include <protocols/wlr-screencopy-unstable-v1.hpp>
 #include <protocols/viewporter.hpp>
+#include <protocols/xdg-output-unstable-v1.hpp>
 #include <protocols/wayland.hpp>
 
 #include <cassert>
@@ -32,6 +35,7 @@
 #include <algorithm>
 #include <filesystem>
 #include <thread>
+#include <chrono>
 #include <unordered_map>
 
 #include <hyprutils/memory/WeakPtr.hpp>
@@ -1,9 +1,29 @@
 #include <strings.h>
+#include <csignal>
 
 #include <iostream>
 
 #include "hyprmagnifier.hpp"
 
+enum eLongOnlyOptions {
+    OPT_LATENCY_HISTOGRAM = 256,
+    OPT_IDLE_TIMEOUT,
+    OPT_LIVE,
+    OPT_STARTUP_TRACE,
+    OPT_STATS,
+    OPT_NO_10BIT,
+    OPT_SHAPE,
+    OPT_BORDER,
+    OPT_FILTER,
+    OPT_SNAPSHOT_FORMAT,
+    OPT_STREAM,
+    OPT_STREAM_FORMAT,
+    OPT_NO_GOVERNOR,
+    OPT_NO_DMABUF,
+    OPT_NO_CURSOR,
+    OPT_FULLSCREEN,
+};
+
 static void help() {
     std::cout << "Hyprmagnifier usage: hyprmagnifier [arg [...]].\n\nArguments:\n"
               << " -h | --help                | Show this help message\n"
@@ -13,9 +33,40 @@ static void help() {
               << " -q | --quiet               | Disable most logs (leaves errors)\n"
               << " -v | --verbose             | Enable more logs\n"
               << " -t | --no-fractional       | Disable fractional scaling support\n"
+              << " -d | --disable-preview     | Hide the color readout under the lens (toggle with c)\n"
+              << " -l | --lowercase-hex       | Lowercase hex codes in the readout\n"
+              << " -P | --predict             | Extrapolate the lens position from pointer velocity\n"
+              << " -D | --daemon              | Stay resident with warm buffers, toggle the lens with SIGUSR2 or --activate\n"
+              << " -a | --activate            | Toggle the lens of a running daemon (starts normally without one)\n"
+              << " -c | --ctl COMMAND         | Send COMMAND to the control socket of a running instance and print the reply\n"
+              << "      --idle-timeout SECS   | Exit (or hide the daemon's lens) after SECS without input\n"
+              << "      --live HZ             | Recapture the output under the lens HZ times a second instead of freezing it\n"
+              << "      --startup-trace       | Print timestamps of every startup (or activation) step per output\n"
+              << "      --stats               | Print shm and heap usage per output on exit (any time with SIGUSR1)\n"
+              << "      --no-10bit            | Render 10-bit captures through the 8-bit path\n"
+              << "      --no-governor         | Keep full quality when frames take longer than the refresh interval\n"
+              << "      --no-dmabuf           | Capture through shm even where udmabuf captures would work\n"
+              << "      --no-cursor           | Leave the pointer out of the lens\n"
+              << "      --fullscreen          | Magnify the whole output under the pointer instead of a lens\n"
+              << "      --shape SHAPE         | Lens shape: rect, circle or rounded[:RADIUS]\n"
+              << "      --border W[:RRGGBBAA] | Lens border width in pixels (0 disables) and color\n"
+              << "      --filter SPEC         | Color filter steps for the lens, comma separated:\n"
+              << "                            |   " << CColorFilter::STEPS << "\n"
+              << "      --snapshot-format F   | Format of snapshots taken with s (lens) and S (whole output): png or jpeg\n"
+              << "      --stream FILE|-       | Write every lens frame to FILE or stdout, frames are dropped for a slow reader\n"
+              << "      --stream-format F     | raw (BGRA) or y4m (I420), by default y4m for a .y4m FILE and raw otherwise\n"
+              << " -L | --latency             | Report input-to-present latency live and on exit\n"
+              << "      --latency-histogram F | Write the latency histogram to F on exit (implies -L)\n"
               << " -V | --version             | Print version info\n";
 }
 
+// hands the activation over to a running daemon, returns false if there is none. Goes through the control socket, a
+// pid read from a file may belong to anything by now
+static bool activateDaemon() {
+    const auto REPLY = CIPCServer::request(CHyprmagnifier::getRuntimePath("hyprmagnifier.sock"), "toggle");
+    return REPLY == "active" || REPLY == "inactive";
+}
+
 int main(int argc, char** argv, char** envp) {
     g_pHyprmagnifier = std::make_unique<CHyprmagnifier>();
 
@@ -26,12 +77,35 @@ int main(int argc, char** argv, char** envp) {
                                                {"help", no_argument, nullptr, 'h'},
                                                {"render-inactive", no_argument, nullptr, 'r'},
                                                {"no-fractional", no_argument, nullptr, 't'},
+                                               {"disable-preview", no_argument, nullptr, 'd'},
+                                               {"lowercase-hex", no_argument, nullptr, 'l'},
                                                {"quiet", no_argument, nullptr, 'q'},
                                                {"verbose", no_argument, nullptr, 'v'},
                                                {"version", no_argument, nullptr, 'V'},
+                                               {"latency", no_argument, nullptr, 'L'},
+                                               {"predict", no_argument, nullptr, 'P'},
+                                               {"daemon", no_argument, nullptr, 'D'},
+                                               {"activate", no_argument, nullptr, 'a'},
+                                               {"ctl", required_argument, nullptr, 'c'},
+                                               {"latency-histogram", required_argument, nullptr, OPT_LATENCY_HISTOGRAM},
+                                               {"idle-timeout", required_argument, nullptr, OPT_IDLE_TIMEOUT},
+                                               {"live", required_argument, nullptr, OPT_LIVE},
+                                               {"startup-trace", no_argument, nullptr, OPT_STARTUP_TRACE},
+                                               {"stats", no_argument, nullptr, OPT_STATS},
+                                               {"no-10bit", no_argument, nullptr, OPT_NO_10BIT},
+                                               {"shape", required_argument, nullptr, OPT_SHAPE},
+                                               {"border", required_argument, nullptr, OPT_BORDER},
+                                               {"filter", required_argument, nullptr, OPT_FILTER},
+                                               {"snapshot-format", required_argument, nullptr, OPT_SNAPSHOT_FORMAT},
+                                               {"stream", required_argument, nullptr, OPT_STREAM},
+                                               {"stream-format", required_argument, nullptr, OPT_STREAM_FORMAT},
+                                               {"no-governor", no_argument, nullptr, OPT_NO_GOVERNOR},
+                                               {"no-dmabuf", no_argument, nullptr, OPT_NO_DMABUF},
+                                               {"no-cursor", no_argument, nullptr, OPT_NO_CURSOR},
+                                               {"fullscreen", no_argument, nullptr, OPT_FULLSCREEN},
                                                {nullptr, 0, nullptr, 0}};
 
-        int                  c = getopt_long(argc, argv, ":f:hnarzqvtdlV", long_options, &option_index);
+        int                  c = getopt_long(argc, argv, ":f:c:hnarzqvtdlVLPD", long_options, &option_index);
         if (c == -1)
             break;
 
@@ -77,6 +151,116 @@ int main(int argc, char** argv, char** envp) {
             case 'v': Debug::verbose = true; break;
             case 'd': g_pHyprmagnifier->m_bDisableHexPreview = true; break;
             case 'l': g_pHyprmagnifier->m_bUseLowerCase = true; break;
+            case 'L': g_pHyprmagnifier->m_bTrackLatency = true; break;
+            case 'P': g_pHyprmagnifier->m_bPredictMotion = true; break;
+            case 'D': g_pHyprmagnifier->m_bDaemon = true; break;
+            case 'a':
+                if (activateDaemon())
+                    exit(0);
+                Debug::log(WARN, "No hyprmagnifier daemon running, starting normally");
+                break;
+            case 'c': {
+                const auto REPLY = CIPCServer::request(CHyprmagnifier::getRuntimePath("hyprmagnifier.sock"), optarg);
+                if (REPLY.empty()) {
+                    Debug::log(NONE, "No hyprmagnifier instance is listening");
+                    exit(1);
+                }
+                std::cout << REPLY << "\n";
+                exit(REPLY.starts_with("error") ? 1 : 0);
+            }
+            case OPT_LATENCY_HISTOGRAM:
+                g_pHyprmagnifier->m_bTrackLatency      = true;
+                g_pHyprmagnifier->m_szLatencyHistogram = optarg;
+                break;
+            case OPT_IDLE_TIMEOUT:
+                try {
+                    g_pHyprmagnifier->m_iIdleTimeoutMs = std::max(std::stod(optarg), 0.0) * 1000.0;
+                } catch (std::exception& e) {
+                    Debug::log(NONE, "Wrong idle timeout: \"%s\". Must be a number of seconds", optarg);
+                    exit(1);
+                }
+                break;
+            case OPT_STARTUP_TRACE: g_pHyprmagnifier->m_bStartupTrace = true; break;
+            case OPT_STATS: g_pHyprmagnifier->m_bMemoryStats = true; break;
+            case OPT_NO_10BIT: g_pHyprmagnifier->m_bNo10Bit = true; break;
+            case OPT_NO_GOVERNOR: g_pHyprmagnifier->m_pGovernor->m_bEnabled = false; break;
+            case OPT_NO_DMABUF: g_pHyprmagnifier->m_bNoDmabuf = true; break;
+            case OPT_NO_CURSOR: g_pHyprmagnifier->m_bNoLensCursor = true; break;
+            case OPT_FULLSCREEN: g_pHyprmagnifier->m_bFullscreen = true; break;
+            case OPT_SHAPE: {
+                const std::string ARG = optarg;
+                if (ARG == "rect")
+                    g_pHyprmagnifier->m_eLensShape = LENS_RECT;
+                else if (ARG == "circle")
+                    g_pHyprmagnifier->m_eLensShape = LENS_CIRCLE;
+                else if (ARG == "rounded" || ARG.starts_with("rounded:")) {
+                    g_pHyprmagnifier->m_eLensShape = LENS_ROUNDED;
+                    try {
+                        if (ARG.size() > 8)
+                            g_pHyprmagnifier->m_dLensRadius = std::max(std::stod(ARG.substr(8)), 0.0);
+                    } catch (std::exception& e) {
+                        Debug::log(NONE, "Wrong shape: \"%s\". Must be rect, circle or rounded[:RADIUS]", optarg);
+                        exit(1);
+                    }
+                } else {
+                    Debug::log(NONE, "Wrong shape: \"%s\". Must be rect, circle or rounded[:RADIUS]", optarg);
+                    exit(1);
+                }
+                break;
+            }
+            case OPT_BORDER: {
+                const std::string ARG   = optarg;
+                const auto        COLON = ARG.find(':');
+                try {
+                    g_pHyprmagnifier->m_dBorderWidth = std::max(std::stod(ARG.substr(0, COLON)), 0.0);
+
+                    if (COLON != std::string::npos) {
+                        const auto HEX = ARG.substr(COLON + 1);
+                        if (HEX.size() != 6 && HEX.size() != 8)
+                            throw std::invalid_argument("color");
+
+                        const uint32_t RGBA = std::stoul(HEX.size() == 6 ? HEX + "FF" : HEX, nullptr, 16);
+                        g_pHyprmagnifier->m_cBorderColor = {.r = (uint8_t)(RGBA >> 24), .g = (uint8_t)(RGBA >> 16), .b = (uint8_t)(RGBA >> 8), .a = (uint8_t)RGBA};
+                    }
+                } catch (std::exception& e) {
+                    Debug::log(NONE, "Wrong border: \"%s\". Must be WIDTH or WIDTH:RRGGBB[AA]", optarg);
+                    exit(1);
+                }
+                break;
+            }
+            case OPT_FILTER:
+                try {
+                    g_pHyprmagnifier->setFilter(optarg);
+                } catch (std::exception& e) {
+                    Debug::log(NONE, "Wrong filter: \"%s\". %s", optarg, e.what());
+                    exit(1);
+                }
+                break;
+            case OPT_SNAPSHOT_FORMAT: {
+                const std::string ARG = optarg;
+                if (ARG != "png" && ARG != "jpeg" && ARG != "jpg") {
+                    Debug::log(NONE, "Wrong snapshot format: \"%s\". Must be png or jpeg", optarg);
+                    exit(1);
+                }
+                g_pHyprmagnifier->m_szSnapshotFormat = ARG == "png" ? "png" : "jpg";
+                break;
+            }
+            case OPT_STREAM: g_pHyprmagnifier->m_szStreamPath = optarg; break;
+            case OPT_STREAM_FORMAT:
+                if (strcmp(optarg, "raw") && strcmp(optarg, "y4m")) {
+                    Debug::log(NONE, "Wrong stream format: \"%s\". Must be raw or y4m", optarg);
+                    exit(1);
+                }
+                g_pHyprmagnifier->m_szStreamFormat = optarg;
+                break;
+            case OPT_LIVE:
+                try {
+                    g_pHyprmagnifier->m_iLiveHz = std::clamp(std::stoi(optarg), 0, 1000);
+                } catch (std::exception& e) {
+                    Debug::log(NONE, "Wrong live rate: \"%s\". Must be a number of captures per second", optarg);
+                    exit(1);
+                }
+                break;
             case 'V': {
                 std::cout << "hyprmagnifier v" << HYPRMAGNIFIER_VERSION << "\n";
                 exit(0);